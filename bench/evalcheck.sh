@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+# Compiles sweet::eval with C++20: a program that runs has to give its
+# output while compiling, and every way the parser can fail has to end in
+# the EvalFailed error carrying sweet's message. Memory a failed parse leaves
+# allocated is a compile error of its own inside a constant expression, so
+# a leak on any of these paths shows up here.
+#
+#     bench/evalcheck.sh
+
+set -euo pipefail
+
+CPP=${CPP:-g++}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+compile() {
+    "$CPP" -std=c++20 -fsyntax-only -Iinclude "$1"
+}
+
+cat > "$WORK/runs.cpp" <<'EOF'
+#include "sweet/eval.hpp"
+
+constexpr auto table = sweet::eval<"a = 6 * 7; if (a > 40) print a;">();
+static_assert(table.output() == "42\n");
+static_assert(table.variableCount() == 1 && table.name(0) == "a");
+EOF
+if ! compile "$WORK/runs.cpp"; then
+    echo "FAIL a program that runs does not compile" >&2
+    exit 1
+fi
+echo "ok   runs"
+
+# the program and the kind of error it has to fail with
+check() {
+    local source=$1 expected=$2
+    printf '#include "sweet/eval.hpp"\nconstexpr auto failed = sweet::eval<"%s">();\n' \
+        "$source" > "$WORK/fails.cpp"
+    local output
+    if output=$(compile "$WORK/fails.cpp" 2>&1); then
+        echo "FAIL '$source' compiled" >&2
+        exit 1
+    fi
+    if ! grep -q "EvalFailed<.*$expected" <<< "$output"; then
+        echo "FAIL '$source' did not fail with $expected:" >&2
+        grep -m 3 "error" <<< "$output" >&2
+        exit 1
+    fi
+    printf 'ok   %-20s %s\n' "$source" "$expected"
+}
+
+check "a = ;" UnexpectedTokenError
+check "a = 1" EndOfFileError
+check "a = 1 2;" UnexpectedTokenError
+check "a = 1 +" EndOfFileError
+check "a" EndOfFileError
+check "a 1;" UnexpectedTokenError
+check "print 1" EndOfFileError
+check "print 1 a;" UnexpectedTokenError
+check "label x" EndOfFileError
+check "label x y;" UnexpectedTokenError
+check "goto x" EndOfFileError
+check "goto x y;" UnexpectedTokenError
+check "if (a) print 1" EndOfFileError
+check "if (a print 1;" UnexpectedTokenError
+check "if (a)" EndOfFileError
@@ -0,0 +1,78 @@
+// Runs a command once and prints, on one line, the nanoseconds it took, the
+// most memory it held in kilobytes, the bytes it wrote to stdout and its exit
+// status. What it writes to stdout is counted and thrown away, its stderr is
+// left alone.
+//
+//     bench/measure <command> [args...]
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static std::int64_t nanoseconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (std::int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: measure <command> [args...]\n");
+        return 1;
+    }
+    int out[2];
+    if (pipe(out) != 0)
+    {
+        std::perror("measure");
+        return 1;
+    }
+
+    auto start = nanoseconds();
+    pid_t child = fork();
+    if (child < 0)
+    {
+        std::perror("measure");
+        return 1;
+    }
+    if (child == 0)
+    {
+        dup2(out[1], 1);
+        close(out[0]);
+        close(out[1]);
+        execvp(argv[1], argv + 1);
+        std::perror(argv[1]);
+        _exit(127);
+    }
+    close(out[1]);
+
+    static char buffer[1 << 16];
+    std::int64_t bytes = 0;
+    for (;;)
+    {
+        auto got = read(out[0], buffer, sizeof(buffer));
+        if (got <= 0)
+            break;
+        bytes += got;
+    }
+    close(out[0]);
+
+    int status;
+    rusage usage;
+    if (wait4(child, &status, 0, &usage) < 0)
+    {
+        std::perror("measure");
+        return 1;
+    }
+    auto elapsed = nanoseconds() - start;
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    std::printf("%lld %ld %lld %d\n", (long long)elapsed, usage.ru_maxrss,
+                (long long)bytes, code);
+    return 0;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env bash
+# Runs every program of bench/corpus, and a huge flat one and a deeply nested
+# one made here, a few times each and writes the median wall time, peak RSS
+# and output throughput of each to a JSON file. The results are compared
+# with a baseline, failing when a program got slower, held more memory or
+# wrote its output slower by more than the threshold and by more than the
+# trials vary.
+#
+#     bench/perfcheck.sh            compare with the baseline
+#     bench/perfcheck.sh --update   make the results the new baseline
+#
+# TRIALS (5), THRESHOLD (percent, 10), RESULTS (build/perfcheck.json) and
+# BASELINE (bench/baseline.json) can be set in the environment.
+
+set -euo pipefail
+
+SWEET=${SWEET:-./sweet}
+MEASURE=${MEASURE:-bench/measure}
+TRIALS=${TRIALS:-5}
+THRESHOLD=${THRESHOLD:-10}
+RESULTS=${RESULTS:-build/perfcheck.json}
+BASELINE=${BASELINE:-bench/baseline.json}
+FLAT=200000
+DEPTH=200000
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# `FLAT` assignments one after another, no jumps at all
+flat() {
+    awk -v count="$1" 'BEGIN {
+        split("a b c d", names, " ")
+        for (i = 0; i < count; i++)
+            printf "%s = %s + %d;\n", names[i % 4 + 1],
+                   names[int(i / 4) % 4 + 1], i % 10
+        print "print a;"
+        print "print d;"
+    }'
+}
+
+# a = 1; then `if (a) ` `depth` times around a print
+nested() {
+    awk -v depth="$1" 'BEGIN {
+        print "a = 1;"
+        for (i = 0; i < depth; i++)
+            printf "if (a) "
+        print "print a;"
+        print "print 7;"
+    }'
+}
+
+# median and median absolute deviation of the numbers on stdin
+spread() {
+    sort -g | awk '
+        { v[NR] = $1 }
+        END {
+            m = NR % 2 ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2
+            for (i = 1; i <= NR; i++)
+                d[i] = v[i] > m ? v[i] - m : m - v[i]
+            sortNumbers(d, NR)
+            mad = NR % 2 ? d[(NR + 1) / 2] : (d[NR / 2] + d[NR / 2 + 1]) / 2
+            printf "%.3f %.3f\n", m, mad
+        }
+        # insertion sort, not every awk has asort()
+        function sortNumbers(a, n,    i, j, t) {
+            for (i = 2; i <= n; i++)
+                for (j = i; j > 1 && a[j - 1] > a[j]; j--)
+                {
+                    t = a[j]; a[j] = a[j - 1]; a[j - 1] = t
+                }
+        }'
+}
+
+flat "$FLAT" > "$WORK/flat.swt"
+nested "$DEPTH" > "$WORK/nested.swt"
+programs=(bench/corpus/*.swt "$WORK/flat.swt" "$WORK/nested.swt")
+
+mkdir -p "$(dirname "$RESULTS")"
+{
+    echo "{"
+    echo "  \"trials\": $TRIALS,"
+    echo "  \"programs\": ["
+} > "$RESULTS"
+for i in "${!programs[@]}"; do
+    program=${programs[$i]}
+    name=$(basename "$program" .swt)
+    : > "$WORK/wall" ; : > "$WORK/rss" ; : > "$WORK/rate"
+    # one run first to fill the page cache, not counted
+    for ((trial = 0; trial <= TRIALS; trial++)); do
+        read -r ns kb bytes status \
+            < <("$MEASURE" "$SWEET" --no-cache "$program")
+        if [[ "$status" != 0 ]]; then
+            echo "FAIL $name: exited with $status" >&2
+            exit 1
+        fi
+        ((trial == 0)) && continue
+        awk -v ns="$ns" 'BEGIN { printf "%.6f\n", ns / 1e6 }' >> "$WORK/wall"
+        echo "$kb" >> "$WORK/rss"
+        awk -v ns="$ns" -v bytes="$bytes" \
+            'BEGIN { printf "%.6f\n", bytes / 1e6 / (ns / 1e9) }' \
+            >> "$WORK/rate"
+    done
+    read -r wall wallMad < <(spread < "$WORK/wall")
+    read -r rss rssMad < <(spread < "$WORK/rss")
+    read -r rate rateMad < <(spread < "$WORK/rate")
+    separator=","
+    ((i == ${#programs[@]} - 1)) && separator=""
+    format='    {"name": "%s", "wall_ms": %s, "wall_mad_ms": %s, '
+    format+='"rss_kb": %s, "rss_mad_kb": %s, "output_bytes": %s, '
+    format+='"mb_per_s": %s, "mb_per_s_mad": %s}%s\n'
+    printf "$format" "$name" "$wall" "$wallMad" "$rss" "$rssMad" "$bytes" \
+        "$rate" "$rateMad" "$separator" >> "$RESULTS"
+done
+{
+    echo "  ]"
+    echo "}"
+} >> "$RESULTS"
+echo "wrote $RESULTS"
+
+if [[ "${1:-}" == "--update" ]]; then
+    cp "$RESULTS" "$BASELINE"
+    echo "wrote $BASELINE"
+    exit 0
+fi
+if [[ ! -f "$BASELINE" ]]; then
+    echo "no baseline at $BASELINE, make one with 'make perfbaseline'" >&2
+    exit 1
+fi
+
+# a metric regressed when it moved the wrong way by more than THRESHOLD
+# percent of the baseline, by more than three robust standard deviations of
+# the noisier of the two runs, and by more than a floor below which nothing
+# is measured reliably. Throughput is only judged for programs that write a
+# megabyte or more
+awk -v threshold="$THRESHOLD" '
+    function field(line, key,    start) {
+        if (!match(line, "\"" key "\": [^,}]*"))
+            return ""
+        start = substr(line, RSTART, RLENGTH)
+        sub(/^"[a-z_]*": /, "", start)
+        gsub(/"/, "", start)
+        return start
+    }
+    function value(line, key) {
+        return field(line, key) + 0
+    }
+    function check(name, what, unit, base, baseMad, now, nowMad, floor,
+                   higherIsWorse,    delta, noise) {
+        delta = higherIsWorse ? now - base : base - now
+        noise = 3 * 1.4826 * (baseMad > nowMad ? baseMad : nowMad)
+        if (delta > base * threshold / 100 && delta > noise && delta > floor)
+        {
+            printf "REGRESSION %s: %s %.1f %s against %.1f %s " \
+                   "(%+.1f%%, noise %.1f %s)\n", name, what, now, unit, base,
+                   unit, 100 * (now - base) / base, noise, unit
+            failed = 1
+        }
+    }
+    FNR == 1 { baseline = FILENAME == ARGV[1] }
+    /"name":/ {
+        name = field($0, "name")
+        if (baseline)
+        {
+            known[name] = $0
+            next
+        }
+        if (!(name in known))
+        {
+            printf "%-10s new, not in the baseline\n", name
+            next
+        }
+        old = known[name]
+        printf "%-10s %9.1f ms (%9.1f)  %8d KB (%8d)  %8.1f MB/s (%8.1f)\n",
+               name, value($0, "wall_ms"), value(old, "wall_ms"),
+               value($0, "rss_kb"), value(old, "rss_kb"),
+               value($0, "mb_per_s"), value(old, "mb_per_s")
+        check(name, "wall time", "ms", value(old, "wall_ms"),
+              value(old, "wall_mad_ms"), value($0, "wall_ms"),
+              value($0, "wall_mad_ms"), 2, 1)
+        check(name, "peak RSS", "KB", value(old, "rss_kb"),
+              value(old, "rss_mad_kb"), value($0, "rss_kb"),
+              value($0, "rss_mad_kb"), 512, 1)
+        if (value(old, "output_bytes") >= 1000000)
+            check(name, "output throughput", "MB/s", value(old, "mb_per_s"),
+                  value(old, "mb_per_s_mad"), value($0, "mb_per_s"),
+                  value($0, "mb_per_s_mad"), 0, 0)
+    }
+    END { exit failed }
+' "$BASELINE" "$RESULTS"
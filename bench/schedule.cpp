@@ -0,0 +1,122 @@
+// Runs thousands of tasks through one Scheduler on a few worker threads:
+// runaway `goto` loops that only stop at their fuel limit, mixed with
+// counting loops, compiled with and without the optimizer, that finish on
+// their own. Fails unless every task is done, every counting loop printed
+// its sum and every task used exactly the fuel its backward jumps cost.
+//
+//     bench/schedule [tasks] [workers] [slice]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sweet.hpp"
+
+// sums 0 to `count` - 1, taking `count` - 1 backward jumps
+static std::string counting(long long count)
+{
+    return "i = 0;\ns = 0;\nlabel top;\ns = s + i;\ni = i + 1;\nif (i < " +
+           std::to_string(count) + ") goto top;\nprint s;\n";
+}
+
+static std::shared_ptr<const sweet::Program>
+compiled(const std::string &source, bool optimize)
+{
+    sweet::CompileOptions options;
+    options.optimize = optimize;
+    auto result = sweet::compile("schedule.swt", source, options);
+    if (result.errors.size())
+    {
+        std::fprintf(stderr, "schedule: the program does not compile\n");
+        std::exit(1);
+    }
+    return result.value;
+}
+
+struct Expected
+{
+    sweet::RunStatus status;
+    std::int64_t used;
+    std::string output;
+};
+
+int main(int argc, char **argv)
+{
+    int tasks = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int workers = argc > 2 ? std::atoi(argv[2]) : 4;
+    std::int64_t slice = argc > 3 ? std::atoll(argv[3]) : 1000;
+    const std::int64_t runawayLimit = 20000;
+
+    auto runaway = compiled("label forever;\ngoto forever;\n", false);
+    std::vector<std::shared_ptr<sweet::Task>> submitted;
+    std::vector<std::unique_ptr<std::ostringstream>> outputs;
+    std::vector<Expected> expected;
+    std::atomic<int> done{0};
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        sweet::Scheduler scheduler(workers, slice);
+        for (int i = 0; i < tasks; i++)
+        {
+            outputs.push_back(std::make_unique<std::ostringstream>());
+            std::shared_ptr<sweet::Task> task;
+            if (i % 4 == 0)
+            {
+                task = std::make_shared<sweet::Task>(runaway, *outputs.back());
+                task->limit = runawayLimit;
+                expected.push_back(
+                    {sweet::RunStatus::SUSPENDED, runawayLimit, ""});
+            }
+            else
+            {
+                long long count = 1 + (i * 7919) % 5000;
+                task = std::make_shared<sweet::Task>(
+                    compiled(counting(count), i % 2), *outputs.back());
+                expected.push_back({sweet::RunStatus::FINISHED, count - 1,
+                                    std::to_string(count * (count - 1) / 2) +
+                                        "\n"});
+            }
+            task->done = [&done](sweet::Task &) { done++; };
+            submitted.push_back(task);
+            scheduler.submit(task);
+        }
+        scheduler.wait();
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    int failures = 0;
+    if (done != tasks)
+    {
+        std::fprintf(stderr, "FAIL %d of %d tasks called done\n", (int)done,
+                     tasks);
+        failures++;
+    }
+    for (int i = 0; i < tasks; i++)
+    {
+        auto &task = *submitted[i];
+        auto output = outputs[i]->str();
+        if (task.result.status != expected[i].status ||
+            task.used != expected[i].used || output != expected[i].output)
+        {
+            if (failures++ < 10)
+                std::fprintf(stderr,
+                             "FAIL task %d: status %d used %lld printed '%s', "
+                             "expected status %d used %lld\n",
+                             i, (int)task.result.status, (long long)task.used,
+                             output.c_str(), (int)expected[i].status,
+                             (long long)expected[i].used);
+        }
+    }
+    if (failures)
+        return 1;
+    std::printf("%d tasks on %d workers in slices of %lld: %lld ms\n", tasks,
+                workers, (long long)slice, (long long)ms);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+# Runs programs with ifs nested a million deep through the lexer, parser,
+# compiler, optimizer and runtime on a small stack, failing if any of them
+# crashes or prints the wrong thing. The ast is printed at a smaller depth,
+# since its indentation makes the printed tree quadratic in the depth.
+#
+#     bench/stress.sh [depth]
+
+set -euo pipefail
+
+SWEET=${SWEET:-./sweet}
+DEPTH=${1:-1000000}
+PRINT_DEPTH=1000
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# a = 1; then `if (a) ` `depth` times around `statement`
+nested() {
+    awk -v depth="$1" -v statement="$2" 'BEGIN {
+        print "a = 1;"
+        for (i = 0; i < depth; i++)
+            printf "if (a) "
+        print statement
+        print "print 7;"
+    }'
+}
+
+check() {
+    local name=$1 expected=$2
+    shift 2
+    local start=$EPOCHREALTIME
+    local output
+    if ! output=$("$@"); then
+        echo "FAIL $name: exited with $?" >&2
+        exit 1
+    fi
+    if [[ "$output" != "$expected" ]]; then
+        echo "FAIL $name: printed '$output', expected '$expected'" >&2
+        exit 1
+    fi
+    awk -v name="$name" -v start="$start" -v end="$EPOCHREALTIME" \
+        'BEGIN { printf "%-28s %8.3f s\n", name, end - start }'
+}
+
+# a fraction of the default 8 MB, so that any recursion per level shows
+ulimit -s 256
+
+nested "$DEPTH" "print a;" > "$WORK/print.swt"
+nested "$DEPTH" "goto end;" > "$WORK/goto.swt"
+echo "label end;" >> "$WORK/goto.swt"
+nested "$PRINT_DEPTH" "print a;" > "$WORK/small.swt"
+
+echo "nesting $DEPTH deep"
+check "run" "$(printf '1\n7')" "$SWEET" --no-cache "$WORK/print.swt"
+check "run -O0" "$(printf '1\n7')" "$SWEET" --no-cache -O0 "$WORK/print.swt"
+check "run goto" "" "$SWEET" --no-cache "$WORK/goto.swt"
+check "run goto -O0" "" "$SWEET" --no-cache -O0 "$WORK/goto.swt"
+check "ast at $PRINT_DEPTH" "$(printf '1\n7')" \
+    bash -c '"$1" --no-cache --ast "$2" | tail -n 2' _ "$SWEET" "$WORK/small.swt"
@@ -0,0 +1,60 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "sweet/serve.hpp"
+using namespace std;
+using namespace sweet;
+
+// sweetc: runs a program on the daemon `sweet --serve` keeps warm, taking the
+// same options as sweet itself
+
+int main(int argc, const char **argv)
+{
+    string socketPath = defaultSocketPath(), filename;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg(argv[i]);
+        if (arg == "--socket" && i + 1 < argc)
+        {
+            socketPath = argv[++i];
+            continue;
+        }
+        args.push_back(arg);
+        if (optionTakesValue(arg) && i + 1 < argc)
+            args.push_back(argv[++i]);
+        else if (arg.size() > 0 && arg[0] != '-')
+            filename = arg;
+    }
+    if (filename.empty())
+    {
+        cerr << "usage: sweetc [--socket <path>] [sweet options] <file>"
+             << endl;
+        return 1;
+    }
+
+    ifstream file(filename, ios::binary);
+    if (!file.good())
+    {
+        cerr << "Error: no such file '" << filename << "' exists." << endl;
+        return 1;
+    }
+    string source((istreambuf_iterator<char>(file)),
+                  istreambuf_iterator<char>());
+    // sweet reads the source line by line, ending the last one as well
+    if (source.size() && source.back() != '\n')
+        source += '\n';
+
+    string error;
+    int status = requestServe(socketPath, args, source, 1, 2, error);
+    if (status < 0)
+    {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,27 @@
+#ifndef SWEET_HPP
+#define SWEET_HPP
+
+#include "sweet/ast.hpp"
+#include "sweet/batch.hpp"
+#include "sweet/cache.hpp"
+#include "sweet/cfg.hpp"
+#include "sweet/channel.hpp"
+#include "sweet/error.hpp"
+#include "sweet/eval.hpp"
+#include "sweet/lexer.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+#include "sweet/parser.hpp"
+#include "sweet/pipeline.hpp"
+#include "sweet/position.hpp"
+#include "sweet/printer.hpp"
+#include "sweet/profiler.hpp"
+#include "sweet/program.hpp"
+#include "sweet/runtime.hpp"
+#include "sweet/scheduler.hpp"
+#include "sweet/serve.hpp"
+#include "sweet/stream.hpp"
+#include "sweet/tier.hpp"
+#include "sweet/token.hpp"
+
+#endif
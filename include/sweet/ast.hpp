@@ -0,0 +1,284 @@
+#ifndef SWEET_AST_HPP
+#define SWEET_AST_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "sweet/memory.hpp"
+#include "sweet/token.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// AST
+// ==================================================
+
+enum class AstType
+{
+    AST_PROGRAM,
+    AST_STATEMENT,
+    AST_ASSIGN,
+    AST_LABEL,
+    AST_GOTO,
+    AST_IF,
+    AST_PRINT,
+    AST_EXPRESSION,
+    AST_PRIMARY,
+    AST_VARIABLE,
+    AST_LITERAL
+};
+
+constexpr const char *astTypeName(AstType type)
+{
+    switch (type)
+    {
+    case AstType::AST_PROGRAM:
+        return "AstProgram";
+    case AstType::AST_STATEMENT:
+        return "AstStatement";
+    case AstType::AST_ASSIGN:
+        return "AstAssign";
+    case AstType::AST_LABEL:
+        return "AstLabel";
+    case AstType::AST_GOTO:
+        return "AstGoto";
+    case AstType::AST_IF:
+        return "AstIf";
+    case AstType::AST_PRINT:
+        return "AstPrint";
+    case AstType::AST_EXPRESSION:
+        return "AstExpression";
+    case AstType::AST_PRIMARY:
+        return "AstPrimary";
+    case AstType::AST_VARIABLE:
+        return "AstVariable";
+    default:
+        return "AstLiteral";
+    }
+}
+
+template <AstType Type>
+struct AstNode
+{
+    static constexpr AstType nodeType = Type;
+};
+
+// a new node, charged to the ast in the memory stats by its type. Nodes are
+// not given an operator new of their own, constant expressions can not call
+// one
+template <typename Node>
+SWEET_CONSTEXPR Node *newNode()
+{
+    MemoryScope scope(MemoryPhase::PHASE_AST, astTypeName(Node::nodeType));
+    return new Node;
+}
+
+struct AstStatement;
+
+struct AstLiteral : AstNode<AstType::AST_LITERAL>
+{
+    Token tokenLiteral;
+};
+
+struct AstVariable : AstNode<AstType::AST_VARIABLE>
+{
+    Token tokenVariable;
+};
+
+struct AstPrimary : AstNode<AstType::AST_PRIMARY>
+{
+    AstType type;
+    union
+    {
+        AstLiteral *astLiteral;
+        AstVariable *astVariable;
+    };
+
+    SWEET_CONSTEXPR ~AstPrimary()
+    {
+        switch (type)
+        {
+        case AstType::AST_LITERAL:
+            delete astLiteral;
+            break;
+        case AstType::AST_VARIABLE:
+            delete astVariable;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+struct AstExpression : AstNode<AstType::AST_EXPRESSION>
+{
+    AstPrimary *left;
+    Token tokenOperator;
+    AstPrimary *right;
+
+    SWEET_CONSTEXPR ~AstExpression()
+    {
+        delete left;
+        delete right;
+    }
+};
+
+struct AstPrint : AstNode<AstType::AST_PRINT>
+{
+    Token tokenPrint;
+    AstExpression *astExpression;
+    Token tokenSemiColon;
+
+    SWEET_CONSTEXPR ~AstPrint()
+    {
+        delete astExpression;
+    }
+};
+
+struct AstIf : AstNode<AstType::AST_IF>
+{
+    Token tokenIf;
+    Token tokenLParen;
+    AstExpression *astExpression;
+    Token tokenRParen;
+    AstStatement *astStatement;
+
+    SWEET_CONSTEXPR ~AstIf();
+};
+
+struct AstGoto : AstNode<AstType::AST_GOTO>
+{
+    Token tokenGoto;
+    AstVariable *astVariable;
+    Token tokenSemiColon;
+
+    SWEET_CONSTEXPR ~AstGoto()
+    {
+        delete astVariable;
+    }
+};
+
+struct AstLabel : AstNode<AstType::AST_LABEL>
+{
+    Token tokenLabel;
+    AstVariable *astVariable;
+    Token tokenSemiColon;
+
+    SWEET_CONSTEXPR ~AstLabel()
+    {
+        delete astVariable;
+    }
+};
+
+struct AstAssign : AstNode<AstType::AST_ASSIGN>
+{
+    AstVariable *astVariable;
+    Token tokenEqual;
+    AstExpression *astExpression;
+    Token tokenSemiColon;
+
+    SWEET_CONSTEXPR ~AstAssign()
+    {
+        delete astVariable;
+        delete astExpression;
+    }
+};
+
+struct AstStatement : AstNode<AstType::AST_STATEMENT>
+{
+    AstType type;
+    union
+    {
+        AstPrint *astPrint;
+        AstIf *astIf;
+        AstGoto *astGoto;
+        AstLabel *astLabel;
+        AstAssign *astAssign;
+    };
+
+    SWEET_CONSTEXPR ~AstStatement()
+    {
+        switch (type)
+        {
+        case AstType::AST_PRINT:
+            delete astPrint;
+            break;
+        case AstType::AST_IF:
+            delete astIf;
+            break;
+        case AstType::AST_GOTO:
+            delete astGoto;
+            break;
+        case AstType::AST_LABEL:
+            delete astLabel;
+            break;
+        case AstType::AST_ASSIGN:
+            delete astAssign;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // position of the first token of the statement
+    SWEET_CONSTEXPR const Position &startPos() const
+    {
+        switch (type)
+        {
+        case AstType::AST_PRINT:
+            return astPrint->tokenPrint.startPos;
+        case AstType::AST_IF:
+            return astIf->tokenIf.startPos;
+        case AstType::AST_GOTO:
+            return astGoto->tokenGoto.startPos;
+        case AstType::AST_LABEL:
+            return astLabel->tokenLabel.startPos;
+        default:
+            return astAssign->astVariable->tokenVariable.startPos;
+        }
+    }
+};
+
+// AstStatement has to be complete before an if can delete its body. Nested
+// ifs are unlinked and deleted one after another, so that tearing down a
+// deep chain of them does not recurse once per level
+SWEET_CONSTEXPR inline AstIf::~AstIf()
+{
+    delete astExpression;
+    auto statement = astStatement;
+    while (statement)
+    {
+        AstStatement *body = nullptr;
+        if (statement->type == AstType::AST_IF)
+        {
+            body = statement->astIf->astStatement;
+            statement->astIf->astStatement = nullptr;
+        }
+        delete statement;
+        statement = body;
+    }
+}
+
+struct AstProgram : AstNode<AstType::AST_PROGRAM>
+{
+    std::vector<AstStatement *> statements;
+
+    SWEET_CONSTEXPR void add(AstStatement *statement)
+    {
+        MemoryScope scope(MemoryPhase::PHASE_AST, "AstProgram");
+        statements.push_back(statement);
+    }
+
+    SWEET_CONSTEXPR ~AstProgram()
+    {
+        for (auto statement : statements)
+        {
+            delete statement;
+        }
+    }
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SWEET_BATCH_HPP
+#define SWEET_BATCH_HPP
+
+#include <string>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/program.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Batch
+// ==================================================
+
+// initial values of some variables for a number of runs of the same program
+struct Columns
+{
+    std::vector<std::string> names;
+    std::vector<std::vector<Value>> values; // values[column][row]
+
+    int rows() const { return values.empty() ? 0 : values[0].size(); }
+};
+
+struct ColumnsResult
+{
+    Columns value;
+    std::vector<Error> errors;
+};
+
+// one line per variable, its name followed by its value in every run:
+//
+//     # a comment
+//     a 1 2 3
+//     b 10 20 30
+//
+// runs the program three times, with a = 1 and b = 10 the first time
+ColumnsResult readColumns(const std::string &filename,
+                          const std::string &source);
+
+// what one row of a batch printed and how it ended
+struct LaneResult
+{
+    RunStatus status = RunStatus::FINISHED;
+    Error error;
+    std::string output;
+};
+
+// rows run side by side, one AVX2 register holds this many values
+const int BATCH_LANES = 4;
+
+// runs `program` once for every row of `columns`, starting from the values in
+// the row and zero for the variables without a column; columns the program
+// does not use are ignored. BATCH_LANES rows run at a time, each instruction
+// working on all of them with SIMD operations while they take the same path
+// and on the lanes that are at it while they do not. The results are those
+// run() gives row by row, which is what runs with `simd` off or on machines
+// without AVX2
+std::vector<LaneResult> runBatch(const Program &program,
+                                 const Columns &columns, bool simd = true);
+
+} // namespace sweet
+
+#endif
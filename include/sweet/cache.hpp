@@ -0,0 +1,63 @@
+#ifndef SWEET_CACHE_HPP
+#define SWEET_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sweet
+{
+
+// ==================================================
+// Output cache
+// ==================================================
+
+// a program has no input, clock or randomness, so what it prints and the
+// status it exits with depend on nothing but its source and the engine
+struct CachedRun
+{
+    std::string out, err;
+    int status = 0;
+};
+
+// changes whenever any source or header of the engine, or main.cpp, changes,
+// so that a cache never outlives the code that filled it
+const std::string &engineVersion();
+
+// SHA-256 of `text` in hex
+std::string sha256(const std::string &text);
+
+// the key of a run: the hash of the engine version and every part, the
+// source, its file name and whatever options change the output
+std::string cacheKey(const std::vector<std::string> &parts);
+
+// $SWEET_CACHE_DIR, $XDG_CACHE_HOME/sweet or ~/.cache/sweet, empty when
+// there is no home to put it in
+std::string defaultCacheDirectory();
+
+// runs kept in `directory`, one file per key; when the files add up to more
+// than `maxBytes` the ones used longest ago are removed. Failing to read or
+// write the directory only makes the cache miss
+struct OutputCache
+{
+    OutputCache(const std::string &directory, std::uint64_t maxBytes);
+
+    // the run stored under `key`, marking it as just used
+    bool lookup(const std::string &key, CachedRun &run);
+
+    // stores `run` under `key`, false if it is too large to keep at all
+    bool store(const std::string &key, const CachedRun &run);
+
+    std::uint64_t maxBytes() const { return limit; }
+
+private:
+    std::string path(const std::string &key) const;
+    void evict();
+
+    std::string directory;
+    std::uint64_t limit;
+};
+
+} // namespace sweet
+
+#endif
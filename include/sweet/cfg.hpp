@@ -0,0 +1,73 @@
+#ifndef SWEET_CFG_HPP
+#define SWEET_CFG_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Control flow graph
+// ==================================================
+
+struct BasicBlock
+{
+    int start, end; // instructions [start, end)
+    std::vector<int> succs, preds;
+};
+
+struct Cfg
+{
+    Cfg(const Program &program);
+
+    std::vector<BasicBlock> blocks; // in instruction order, entry first
+    std::vector<int> blockOf;       // block of every instruction
+
+    // blocks that can be reached from the entry
+    std::vector<bool> reachable() const;
+};
+
+// ==================================================
+// Liveness
+// ==================================================
+
+// a set of non constant slots
+struct SlotSet
+{
+    SlotSet(int size = 0) : words((size + 63) / 64) {}
+
+    bool test(int slot) const { return words[slot / 64] >> (slot % 64) & 1; }
+    void set(int slot) { words[slot / 64] |= 1ull << (slot % 64); }
+    void reset(int slot) { words[slot / 64] &= ~(1ull << (slot % 64)); }
+
+    // adds every slot of `other`, true when that added any
+    bool unite(const SlotSet &other)
+    {
+        bool changed = false;
+        for (int i = 0; i < words.size(); i++)
+        {
+            auto merged = words[i] | other.words[i];
+            changed |= merged != words[i];
+            words[i] = merged;
+        }
+        return changed;
+    }
+
+    std::vector<std::uint64_t> words;
+};
+
+// slots whose current value may still be read, at the boundaries of every
+// block; nothing is live once the program halts
+struct Liveness
+{
+    Liveness(const Program &program, const Cfg &cfg);
+
+    std::vector<SlotSet> liveIn, liveOut;
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SWEET_CHANNEL_HPP
+#define SWEET_CHANNEL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace sweet
+{
+
+// ==================================================
+// Channel
+// ==================================================
+
+// bounded queue between threads; push() blocks while it is full, pop() while
+// it is empty and fails once it is closed and drained
+template <typename T>
+struct Channel
+{
+    Channel(std::size_t capacity) : capacity{capacity} {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    bool closed = false;
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SWEET_ERROR_HPP
+#define SWEET_ERROR_HPP
+
+#include <ostream>
+#include <string>
+
+#include "sweet/position.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Error
+// ==================================================
+
+enum struct ErrorType
+{
+    ILLEGAL_CHARACTER_ERROR,
+    UNEXPECTED_TOKEN_ERROR,
+    EOF_ERROR,
+    UNDEFINED_LABEL_ERROR,
+    DUPLICATE_LABEL_ERROR,
+    OVERFLOW_ERROR,
+    DIVISION_BY_ZERO_ERROR,
+    INPUT_ERROR,
+    NO_ERROR,
+};
+
+constexpr const char *errorName(ErrorType type)
+{
+    switch (type)
+    {
+    case ErrorType::ILLEGAL_CHARACTER_ERROR:
+        return "IllegalCharacterError";
+    case ErrorType::UNEXPECTED_TOKEN_ERROR:
+        return "UnexpectedTokenError";
+    case ErrorType::EOF_ERROR:
+        return "EndOfFileError";
+    case ErrorType::UNDEFINED_LABEL_ERROR:
+        return "UndefinedLabelError";
+    case ErrorType::DUPLICATE_LABEL_ERROR:
+        return "DuplicateLabelError";
+    case ErrorType::OVERFLOW_ERROR:
+        return "OverflowError";
+    case ErrorType::DIVISION_BY_ZERO_ERROR:
+        return "DivisionByZeroError";
+    case ErrorType::INPUT_ERROR:
+        return "InputError";
+    case ErrorType::NO_ERROR:
+        return "NoError";
+    }
+    return "UnknownError";
+}
+
+struct Error
+{
+    ErrorType typ;             // error type
+    std::string deets;         // details regarding the error
+    Position startPos, endPos; // start and end positions
+
+    SWEET_CONSTEXPR Error()
+        : typ{ErrorType::NO_ERROR} {}
+    SWEET_CONSTEXPR Error(ErrorType type, std::string details, Position start,
+                          Position end)
+        : typ{type}, deets{details}, startPos{start}, endPos{end} {}
+};
+
+inline std::ostream &operator<<(std::ostream &out, const Error &error)
+{
+    out << error.startPos << " " << errorName(error.typ)
+        << ": " << error.deets;
+    return out;
+}
+
+// ==================================================
+// Remark
+// ==================================================
+
+// something the optimizer did that the user may want to know about
+struct Remark
+{
+    std::string deets;         // what was done
+    Position startPos, endPos; // code it was done to
+
+    Remark() {}
+    Remark(std::string details, Position start, Position end)
+        : deets{details}, startPos{start}, endPos{end} {}
+};
+
+inline std::ostream &operator<<(std::ostream &out, const Remark &remark)
+{
+    out << remark.startPos << " Remark: " << remark.deets;
+    return out;
+}
+
+} // namespace sweet
+
+#endif
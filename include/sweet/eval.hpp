@@ -0,0 +1,475 @@
+#ifndef SWEET_EVAL_HPP
+#define SWEET_EVAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sweet/ast.hpp"
+#include "sweet/error.hpp"
+#include "sweet/lexer.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/parser.hpp"
+#include "sweet/program.hpp"
+
+#if SWEET_HAS_CONSTEXPR
+
+namespace sweet
+{
+
+// ==================================================
+// Compile time evaluation
+// ==================================================
+
+// the source of a program as a template argument, so that eval<"...">()
+// takes a string literal
+template <std::size_t N>
+struct SourceText
+{
+    char text[N];
+
+    consteval SourceText(const char (&source)[N])
+    {
+        for (std::size_t i = 0; i < N; i++)
+            text[i] = source[i];
+    }
+
+    constexpr std::string_view view() const { return {text, N - 1}; }
+};
+
+// what a program run by eval() printed and the variables it finished with,
+// in the order the program first uses them
+template <std::size_t OutputSize, std::size_t VariableCount,
+          std::size_t NameSize>
+struct Evaluation
+{
+    char text[OutputSize + 1] = {};
+    char nameText[NameSize + 1] = {};       // the names one after another
+    std::size_t nameEnds[VariableCount + 1] = {};
+    Value slots[VariableCount + 1] = {};
+
+    constexpr std::string_view output() const { return {text, OutputSize}; }
+
+    static constexpr std::size_t variableCount() { return VariableCount; }
+
+    constexpr std::string_view name(std::size_t variable) const
+    {
+        std::size_t start = variable ? nameEnds[variable - 1] : 0;
+        return {nameText + start, nameEnds[variable] - start};
+    }
+
+    // value of the variable `name`, false when the program does not use it
+    constexpr bool get(std::string_view name, Value &value) const
+    {
+        for (std::size_t i = 0; i < VariableCount; i++)
+            if (this->name(i) == name)
+            {
+                value = slots[i];
+                return true;
+            }
+        return false;
+    }
+
+    // value of the variable `name`, 0 when the program does not use it as
+    // for one it never set
+    constexpr Value value(std::string_view name) const
+    {
+        Value value = 0;
+        get(name, value);
+        return value;
+    }
+};
+
+namespace detail
+{
+
+// what running a program came to. Nothing allocated can leave a constant
+// expression, so eval() runs it once for the sizes and once more to copy
+// this out
+struct EvalState
+{
+    std::string error; // the first error as sweet prints it, "" if none
+    std::string output;
+    std::vector<std::string> names;
+    std::vector<Value> slots;
+};
+
+constexpr std::string toString(std::int64_t value)
+{
+    // INT64_MIN has no positive counterpart, its digits come from the
+    // unsigned magnitude
+    std::uint64_t magnitude =
+        value < 0 ? 0 - (std::uint64_t)value : (std::uint64_t)value;
+    std::string digits;
+    do
+    {
+        digits.push_back('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        digits.push_back('-');
+    return std::string(digits.rbegin(), digits.rend());
+}
+
+constexpr std::string formatError(const Error &error)
+{
+    return error.startPos.fname + ":" + toString(error.startPos.ln) + ":" +
+           toString(error.startPos.col) + " " + errorName(error.typ) + ": " +
+           error.deets;
+}
+
+// runs the tree the parser built. The compiler and the runtime keep their
+// tables in containers that are not constexpr, this makes the same checks
+// in the same order and stops with the same errors
+struct Evaluator
+{
+    constexpr Evaluator(AstProgram *program) : program{program} {}
+
+    // what the compiler checks: literals that do not fit, labels defined
+    // twice, then gotos to labels that are not defined
+    constexpr bool check()
+    {
+        auto &statements = program->statements;
+        for (int i = 0; i < statements.size(); i++)
+        {
+            auto statement = statements[i];
+            while (statement->type == AstType::AST_IF)
+            {
+                if (!checkExpression(statement->astIf->astExpression))
+                    return false;
+                statement = statement->astIf->astStatement;
+            }
+            switch (statement->type)
+            {
+            case AstType::AST_ASSIGN:
+                if (!checkExpression(statement->astAssign->astExpression))
+                    return false;
+                variable(statement->astAssign->astVariable->tokenVariable.lex);
+                break;
+            case AstType::AST_LABEL:
+            {
+                // a label does nothing, so one in the body of an if is
+                // reached by going on after the if
+                auto &token = statement->astLabel->astVariable->tokenVariable;
+                if (label(token.lex) >= 0)
+                    return fail(ErrorType::DUPLICATE_LABEL_ERROR,
+                                "label '" + token.lex + "' is already defined.",
+                                token.startPos);
+                labels.push_back({token.lex, i + 1});
+                break;
+            }
+            case AstType::AST_GOTO:
+                gotos.push_back(
+                    &statement->astGoto->astVariable->tokenVariable);
+                break;
+            case AstType::AST_PRINT:
+                if (!checkExpression(statement->astPrint->astExpression))
+                    return false;
+                break;
+            default:
+                break;
+            }
+        }
+        for (auto token : gotos)
+            if (label(token->lex) < 0)
+                return fail(ErrorType::UNDEFINED_LABEL_ERROR,
+                            "label '" + token->lex + "' is not defined.",
+                            token->startPos);
+        return true;
+    }
+
+    constexpr void run()
+    {
+        auto &statements = program->statements;
+        int pc = 0;
+        while (pc < statements.size())
+        {
+            auto statement = statements[pc++];
+            while (statement && statement->type == AstType::AST_IF)
+            {
+                Value condition;
+                if (!evaluate(statement, statement->astIf->astExpression,
+                              condition))
+                    return;
+                statement = condition ? statement->astIf->astStatement
+                                      : nullptr;
+            }
+            if (!statement)
+                continue;
+
+            Value value;
+            switch (statement->type)
+            {
+            case AstType::AST_ASSIGN:
+            {
+                auto astAssign = statement->astAssign;
+                if (!evaluate(statement, astAssign->astExpression, value))
+                    return;
+                state.slots[variable(
+                    astAssign->astVariable->tokenVariable.lex)] = value;
+                break;
+            }
+            case AstType::AST_GOTO:
+                pc = label(statement->astGoto->astVariable->tokenVariable.lex);
+                break;
+            case AstType::AST_PRINT:
+                if (!evaluate(statement, statement->astPrint->astExpression,
+                              value))
+                    return;
+                state.output += toString(value);
+                state.output.push_back('\n');
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    EvalState state;
+
+private:
+    AstProgram *program;
+    std::vector<std::pair<std::string, int>> labels; // statement after each
+    std::vector<const Token *> gotos;
+
+    constexpr bool fail(ErrorType type, std::string details,
+                        const Position &pos)
+    {
+        state.error = formatError(Error(type, details, pos, pos));
+        return false;
+    }
+
+    // slot of the variable `name`, a new one the first time it is seen
+    constexpr int variable(const std::string &name)
+    {
+        for (int i = 0; i < state.names.size(); i++)
+            if (state.names[i] == name)
+                return i;
+        state.names.push_back(name);
+        state.slots.push_back(0);
+        return state.names.size() - 1;
+    }
+
+    constexpr int label(const std::string &name) const
+    {
+        for (auto &entry : labels)
+            if (entry.first == name)
+                return entry.second;
+        return -1;
+    }
+
+    static constexpr bool literal(const Token &token, Value &value)
+    {
+        value = 0;
+        for (auto c : token.lex)
+            if (__builtin_mul_overflow(value, 10, &value) ||
+                __builtin_add_overflow(value, c - '0', &value))
+                return false;
+        return true;
+    }
+
+    constexpr bool checkPrimary(AstPrimary *primary)
+    {
+        if (primary->type == AstType::AST_VARIABLE)
+        {
+            variable(primary->astVariable->tokenVariable.lex);
+            return true;
+        }
+        auto &token = primary->astLiteral->tokenLiteral;
+        Value value;
+        if (literal(token, value))
+            return true;
+        return fail(ErrorType::OVERFLOW_ERROR,
+                    "literal '" + token.lex +
+                        "' does not fit in a 64 bit integer.",
+                    token.startPos);
+    }
+
+    constexpr bool checkExpression(AstExpression *expression)
+    {
+        return checkPrimary(expression->left) &&
+               (!expression->right || checkPrimary(expression->right));
+    }
+
+    constexpr Value primary(AstPrimary *primary)
+    {
+        Value value = 0;
+        if (primary->type == AstType::AST_VARIABLE)
+            value = state.slots[variable(
+                primary->astVariable->tokenVariable.lex)];
+        else
+            literal(primary->astLiteral->tokenLiteral, value);
+        return value;
+    }
+
+    // errors while running are reported at the statement that was running,
+    // the way the runtime reports them
+    constexpr bool evaluate(AstStatement *statement, AstExpression *expression,
+                            Value &value)
+    {
+        auto a = primary(expression->left);
+        if (!expression->right)
+        {
+            value = a;
+            return true;
+        }
+        auto b = primary(expression->right);
+        auto &pos = statement->startPos();
+        switch (expression->tokenOperator.typ)
+        {
+        case TokenType::TT_PLUS:
+            if (__builtin_add_overflow(a, b, &value))
+                return fail(ErrorType::OVERFLOW_ERROR,
+                            "result of '+' does not fit in 64 bits.", pos);
+            return true;
+        case TokenType::TT_MINUS:
+            if (__builtin_sub_overflow(a, b, &value))
+                return fail(ErrorType::OVERFLOW_ERROR,
+                            "result of '-' does not fit in 64 bits.", pos);
+            return true;
+        case TokenType::TT_MULTIPLY:
+            if (__builtin_mul_overflow(a, b, &value))
+                return fail(ErrorType::OVERFLOW_ERROR,
+                            "result of '*' does not fit in 64 bits.", pos);
+            return true;
+        case TokenType::TT_DIVIDE:
+            if (b == 0)
+                return fail(ErrorType::DIVISION_BY_ZERO_ERROR,
+                            "division by zero.", pos);
+            if (b == -1 && a == INT64_MIN)
+                return fail(ErrorType::OVERFLOW_ERROR,
+                            "result of '/' does not fit in 64 bits.", pos);
+            value = a / b;
+            return true;
+        case TokenType::TT_EQUAL_EQUAL:
+            value = a == b;
+            return true;
+        case TokenType::TT_LESS:
+            value = a < b;
+            return true;
+        case TokenType::TT_LESS_EQUAL:
+            value = a <= b;
+            return true;
+        case TokenType::TT_GREATER:
+            value = a > b;
+            return true;
+        default:
+            value = a >= b;
+            return true;
+        }
+    }
+};
+
+// lexes, parses, checks and runs `source`, stopping at the first error
+constexpr EvalState evaluate(std::string_view source)
+{
+    EvalState state;
+    std::string text(source);
+    Lexer lexer("<eval>", text);
+    auto tokens = lexer.tokenize();
+    if (tokens.errors.size())
+    {
+        state.error = formatError(tokens.errors[0]);
+        return state;
+    }
+    Parser parser(std::move(tokens.value));
+    auto program = parser.parseProgram();
+    if (!program)
+    {
+        state.error = formatError(parser.errors[0]);
+        return state;
+    }
+    Evaluator evaluator(program);
+    if (evaluator.check())
+        evaluator.run();
+    delete program;
+    return std::move(evaluator.state);
+}
+
+struct EvalSizes
+{
+    std::size_t error, output, variables, names;
+};
+
+constexpr EvalSizes measure(std::string_view source)
+{
+    auto state = evaluate(source);
+    EvalSizes sizes{state.error.size(), state.output.size(),
+                    state.names.size(), 0};
+    for (auto &name : state.names)
+        sizes.names += name.size();
+    return sizes;
+}
+
+template <SourceText Source, std::size_t OutputSize,
+          std::size_t VariableCount, std::size_t NameSize>
+constexpr auto fill()
+{
+    auto state = evaluate(Source.view());
+    Evaluation<OutputSize, VariableCount, NameSize> result;
+    for (std::size_t i = 0; i < OutputSize; i++)
+        result.text[i] = state.output[i];
+    std::size_t end = 0;
+    for (std::size_t i = 0; i < VariableCount; i++)
+    {
+        for (auto c : state.names[i])
+            result.nameText[end++] = c;
+        result.nameEnds[i] = end;
+        result.slots[i] = state.slots[i];
+    }
+    return result;
+}
+
+template <std::size_t N>
+struct ErrorText
+{
+    char text[N];
+};
+
+template <SourceText Source, std::size_t Size>
+constexpr auto errorText()
+{
+    auto state = evaluate(Source.view());
+    ErrorText<Size + 1> result{};
+    for (std::size_t i = 0; i < Size; i++)
+        result.text[i] = state.error[i];
+    return result;
+}
+
+// the compiler prints the template argument of a failed instantiation, which
+// is where the error of the program ends up
+template <auto Message>
+struct EvalFailed
+{
+    static_assert(Message.text[0] == 0,
+                  "sweet::eval: the program has an error, it is the text of "
+                  "the ErrorText in the template argument above");
+};
+
+} // namespace detail
+
+// runs `Source` while compiling. A program that does not compile or stops
+// with an error is a compile error carrying the message sweet would print
+template <SourceText Source>
+consteval auto eval()
+{
+    constexpr auto sizes = detail::measure(Source.view());
+    if constexpr (sizes.error > 0)
+    {
+        detail::EvalFailed<detail::errorText<Source, sizes.error>()> failed;
+        (void)failed;
+        return Evaluation<0, 0, 0>();
+    }
+    else
+        return detail::fill<Source, sizes.output, sizes.variables,
+                            sizes.names>();
+}
+
+} // namespace sweet
+
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef SWEET_LEXER_HPP
+#define SWEET_LEXER_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/position.hpp"
+#include "sweet/token.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Lexer
+// ==================================================
+
+struct LexerResult
+{
+    std::vector<Token> value;
+    std::vector<Error> errors;
+};
+
+struct Lexer
+{
+    // `source` must outlive the lexer
+    SWEET_CONSTEXPR Lexer(std::string filename, const std::string &source)
+        : src{source}, currentPos{filename} {}
+    // `source` is the part of a longer input that starts at `start`, the
+    // tokens carry on its lines and columns while their indices count from
+    // the start of `source`
+    SWEET_CONSTEXPR Lexer(const Position &start, const std::string &source)
+        : src{source}, currentPos{start}
+    {
+        currentPos.idx = 0;
+    }
+
+    // the tokens are moved out, so a lexer tokenizes only once
+    SWEET_CONSTEXPR LexerResult tokenize()
+    {
+        MemoryScope scope(MemoryPhase::PHASE_LEXER);
+        while (currentPos.idx < src.size())
+        {
+            getToken();
+        }
+        return std::move(result);
+    }
+
+private:
+    const std::string &src;
+    LexerResult result;
+    Position currentPos;
+
+    // what <cctype> says in the "C" locale, which is not constexpr
+    static constexpr bool isdigit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool isalpha(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    SWEET_CONSTEXPR char currentChar() const
+    {
+        if (currentPos.idx >= src.size())
+            return 0;
+        return src[currentPos.idx];
+    }
+
+    SWEET_CONSTEXPR void advance()
+    {
+        if (currentPos.idx >= src.size())
+            return;
+        currentPos.advance(src[currentPos.idx]);
+    }
+
+    SWEET_CONSTEXPR void getToken()
+    {
+        MemoryScope scope("Token");
+        auto previousPos = currentPos;
+        // checking if whitespace
+        if (currentChar() == ' ' ||
+            currentChar() == '\n' ||
+            currentChar() == '\t')
+        {
+            advance();
+        }
+        // checking if literal
+        else if (isdigit(currentChar()))
+        {
+            std::string lexical = "";
+            while (isdigit(currentChar()))
+            {
+                lexical.push_back(currentChar());
+                advance();
+            }
+            result.value.push_back(
+                Token(TokenType::TT_LITERAL, lexical, previousPos, currentPos));
+        }
+        // checking if variable
+        else if (isalpha(currentChar()) || currentChar() == '_')
+        {
+            std::string lexical = "";
+            while (isalpha(currentChar()) ||
+                   isdigit(currentChar()) ||
+                   currentChar() == '_')
+            {
+                lexical.push_back(currentChar());
+                advance();
+            }
+            // check if the variable is a keyword
+            result.value.push_back(Token(keywordType(lexical), lexical,
+                                         previousPos, currentPos));
+        }
+        // checking if symbol
+        else if (
+            currentChar() == '=' ||
+            currentChar() == ';' ||
+            currentChar() == '(' ||
+            currentChar() == ')' ||
+            currentChar() == '<' ||
+            currentChar() == '>' ||
+            currentChar() == '+' ||
+            currentChar() == '-' ||
+            currentChar() == '*' ||
+            currentChar() == '/')
+        {
+            std::string lexical = std::string(1, currentChar());
+            advance();
+            // checking if < or > or = follows by =
+            if ((lexical == "=" || lexical == "<" || lexical == ">") &&
+                currentChar() == '=')
+            {
+                lexical.push_back(currentChar());
+                advance();
+            }
+            result.value.push_back(
+                Token(symbolType(lexical), lexical, previousPos, currentPos));
+        }
+        else
+        {
+            std::string details = "unexpected character '" +
+                                  std::string(1, currentChar()) +
+                                  "' found.";
+            advance();
+            MemoryScope scope("Error");
+            result.errors.push_back(Error(ErrorType::ILLEGAL_CHARACTER_ERROR,
+                                          details, previousPos, currentPos));
+        }
+    }
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef SWEET_MEMORY_HPP
+#define SWEET_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 202002L
+#include <type_traits>
+#include <version>
+#endif
+
+// the lexer, the parser and the ast are constexpr where the standard library
+// can allocate in constant expressions, which takes C++20. eval.hpp runs
+// programs with them while compiling
+#if defined(__cpp_constexpr_dynamic_alloc) &&                                  \
+    defined(__cpp_lib_constexpr_string) &&                                     \
+    defined(__cpp_lib_constexpr_vector) &&                                     \
+    defined(__cpp_lib_is_constant_evaluated)
+#define SWEET_CONSTEXPR constexpr
+#define SWEET_HAS_CONSTEXPR 1
+#else
+#define SWEET_CONSTEXPR
+#define SWEET_HAS_CONSTEXPR 0
+#endif
+
+namespace sweet
+{
+
+// true while the compiler evaluates a constant expression, where there are
+// no thread locals and nothing to keep memory stats for
+constexpr bool constantEvaluated()
+{
+#if SWEET_HAS_CONSTEXPR
+    return std::is_constant_evaluated();
+#else
+    return false;
+#endif
+}
+
+// ==================================================
+// Memory accounting
+// ==================================================
+
+// the part of the pipeline an allocation is charged to
+enum struct MemoryPhase
+{
+    PHASE_OTHER,
+    PHASE_LEXER,
+    PHASE_PARSER,
+    PHASE_AST, // the nodes of the tree, whoever allocates them
+    PHASE_PRINTER,
+    PHASE_COMPILER,
+    PHASE_OPTIMIZER,
+    PHASE_RUNTIME,
+    PHASE_COUNT
+};
+
+const char *memoryPhaseName(MemoryPhase phase);
+
+// what allocations made on this thread are charged to
+struct MemoryTag
+{
+    MemoryPhase phase;
+    const char *type; // nullptr when nothing more specific is known
+};
+
+inline thread_local MemoryTag memoryTag = {MemoryPhase::PHASE_OTHER, nullptr};
+
+// charges the allocations made while it is alive to a phase and/or a type,
+// restoring the previous ones when it goes away. Costs a couple of thread
+// local stores whether tracking is on or not
+struct MemoryScope
+{
+    SWEET_CONSTEXPR MemoryScope(MemoryPhase phase, const char *type = nullptr)
+    {
+        if (constantEvaluated())
+            return;
+        previous = memoryTag;
+        memoryTag = MemoryTag{phase, type};
+    }
+    // keeps the phase, only the type changes
+    SWEET_CONSTEXPR MemoryScope(const char *type)
+    {
+        if (constantEvaluated())
+            return;
+        previous = memoryTag;
+        memoryTag.type = type;
+    }
+    SWEET_CONSTEXPR ~MemoryScope()
+    {
+        if (!constantEvaluated())
+            memoryTag = previous;
+    }
+
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope &operator=(const MemoryScope &) = delete;
+
+private:
+    MemoryTag previous = {MemoryPhase::PHASE_OTHER, nullptr};
+};
+
+// the library does not see allocations by itself; an executable that wants
+// them replaces the global operator new and delete and reports every block
+// while memoryTracking() is on, the way main.cpp does for --mem-stats
+void setMemoryTracking(bool on);
+bool memoryTracking();
+void recordAllocation(void *block, std::size_t size);
+// blocks allocated while tracking was off are ignored
+void recordDeallocation(void *block);
+
+struct AllocationStats
+{
+    std::int64_t count = 0; // allocations made
+    std::int64_t bytes = 0; // bytes requested by them
+    std::int64_t live = 0;  // bytes not given back yet
+    std::int64_t peak = 0;  // most bytes live at the same time
+};
+
+struct TypeStats
+{
+    MemoryPhase phase;
+    std::string type; // "" for allocations without a type
+    AllocationStats stats;
+};
+
+struct MemoryStats
+{
+    AllocationStats total;
+    AllocationStats phases[(int)MemoryPhase::PHASE_COUNT];
+    std::vector<TypeStats> types; // by phase, then by bytes
+};
+
+// snapshot of everything recorded so far
+MemoryStats memoryStats();
+
+void printMemoryStats(std::ostream &out, const MemoryStats &stats);
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef SWEET_OPTIMIZER_HPP
+#define SWEET_OPTIMIZER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/profiler.hpp"
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Optimizer
+// ==================================================
+
+// the values from lo to hi, none when lo > hi
+struct ValueRange
+{
+    Value lo = INT64_MIN, hi = INT64_MAX;
+
+    bool empty() const { return lo > hi; }
+};
+
+struct VariableRange
+{
+    std::string name;
+    bool assigned = false; // the program stores to it at all
+    ValueRange range;      // every value it stores
+};
+
+// what the value range analysis found out
+struct RangeReport
+{
+    std::vector<VariableRange> variables;
+    int removedChecks = 0;   // overflow and division by zero checks
+    int remainingChecks = 0; // checks that may still fail
+};
+
+// the range of every variable with the narrowest integer type that holds it
+void printRanges(std::ostream &out, const RangeReport &report);
+
+// what the value numbering found out, and the program before and after
+// every pass
+struct ValueReport
+{
+    int reused = 0;     // operations replaced by a copy of an earlier result
+    int copies = 0;     // copies to a slot that already held the value
+    int propagated = 0; // operands read from where their value came from
+    int instructions[2] = {0, 0};
+    int variables[2] = {0, 0}; // slots the code reads or writes
+};
+
+void printValues(std::ostream &out, const ValueReport &report);
+
+struct OptimizerResult
+{
+    std::shared_ptr<const Program> value = nullptr;
+    std::vector<Remark> remarks;
+    RangeReport ranges;
+    ValueReport values;
+};
+
+// rewrites a program into one that prints the same output and fails with the
+// same errors, but whose variables may end up with different values. With a
+// `profile` of earlier runs of the same source it lays the code out for the
+// ways those runs went and only rewrites the loops that went round enough
+struct Optimizer
+{
+    Optimizer(const Program &program, const SourceProfile *profile = nullptr);
+
+    OptimizerResult optimize();
+
+private:
+    std::shared_ptr<Program> program;
+    const SourceProfile *profile;
+    OptimizerResult results;
+
+    // values.cpp
+    bool numberValues();
+
+    // liveness.cpp
+    bool eliminateUnreachable();
+    bool eliminateDeadStores();
+
+    // induction.cpp
+    bool optimizeLoops();
+    bool optimizeLoop(int header, int latch, const std::vector<int> &jumpsInto);
+
+    // ranges.cpp
+    bool narrowRanges();
+
+    // layout.cpp
+    bool layoutBlocks();
+
+    // drops the instructions marked in `removed`, jumps to one of them go to
+    // the next instruction that stays
+    void removeInstructions(const std::vector<bool> &removed);
+    // puts `inserted` in front of instruction `at`; jumps to `at` go to the
+    // first inserted instruction when `entry` is set, otherwise they keep
+    // going to the instruction that was there. The targets of the inserted
+    // instructions are taken as they are
+    void insertInstructions(int at, const std::vector<Instruction> &inserted,
+                            bool entry);
+    // slot holding the constant `value`
+    int constant(Value value);
+    void remark(int stmt, std::string details);
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,410 @@
+#ifndef SWEET_PARSER_HPP
+#define SWEET_PARSER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sweet/ast.hpp"
+#include "sweet/error.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/token.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Parser
+// ==================================================
+
+struct ParserResult
+{
+    std::shared_ptr<AstProgram> value = nullptr;
+    std::vector<Error> errors;
+};
+
+struct Parser
+{
+    SWEET_CONSTEXPR Parser(std::vector<Token> program)
+        : cur{0}, tokens{std::move(program)} {}
+
+    ParserResult parse()
+    {
+        MemoryScope scope(MemoryPhase::PHASE_PARSER);
+        ParserResult results;
+        results.value = std::shared_ptr<AstProgram>(parseProgram());
+        results.errors = errors;
+        return results;
+    }
+
+    // parse() for constant expressions, which have no shared_ptr. The
+    // program is the caller's to delete, null when `errors` is not empty
+    SWEET_CONSTEXPR AstProgram *parseProgram()
+    {
+        MemoryScope scope(MemoryPhase::PHASE_PARSER);
+        AstProgram *program = newNode<AstProgram>();
+        while (cur < tokens.size())
+        {
+            auto statement = parseStatement();
+            if (statement == nullptr)
+            {
+                delete program;
+                return nullptr;
+            }
+            program->add(statement);
+        }
+        return program;
+    }
+
+    std::vector<Error> errors;
+
+private:
+    int cur;
+    std::vector<Token> tokens;
+
+    // nested ifs are parsed in a loop rather than by recursing into their
+    // bodies, so that how deep they go is not limited by the stack
+    SWEET_CONSTEXPR AstStatement *parseStatement()
+    {
+        std::vector<AstIf *> ifs;
+        while (cur < tokens.size() && tokens[cur].typ == TokenType::TT_IF)
+        {
+            auto res = parseIf();
+            if (res == nullptr)
+                return deleteIfs(ifs);
+            ifs.push_back(res);
+        }
+        if (cur >= tokens.size())
+        {
+            eofError(tokens.back(), "statement");
+            return deleteIfs(ifs);
+        }
+
+        auto statement = parseSimpleStatement();
+        if (statement == nullptr)
+            return deleteIfs(ifs);
+        while (!ifs.empty())
+        {
+            ifs.back()->astStatement = statement;
+            statement = newNode<AstStatement>();
+            statement->type = AstType::AST_IF;
+            statement->astIf = ifs.back();
+            ifs.pop_back();
+        }
+        return statement;
+    }
+
+    SWEET_CONSTEXPR AstStatement *deleteIfs(std::vector<AstIf *> &ifs)
+    {
+        for (auto astIf : ifs)
+            delete astIf;
+        ifs.clear();
+        return nullptr;
+    }
+
+    // any statement but an if
+    SWEET_CONSTEXPR AstStatement *parseSimpleStatement()
+    {
+        if (tokens[cur].typ == TokenType::TT_VARIABLE)
+        {
+            auto res = parseAssign();
+            if (res == nullptr)
+                return nullptr;
+            auto ast = newNode<AstStatement>();
+            ast->type = AstType::AST_ASSIGN;
+            ast->astAssign = res;
+            return ast;
+        }
+        if (tokens[cur].typ == TokenType::TT_LABEL)
+        {
+            auto res = parseLabel();
+            if (res == nullptr)
+                return nullptr;
+            auto ast = newNode<AstStatement>();
+            ast->type = AstType::AST_LABEL;
+            ast->astLabel = res;
+            return ast;
+        }
+        if (tokens[cur].typ == TokenType::TT_GOTO)
+        {
+            auto res = parseGoto();
+            if (res == nullptr)
+                return nullptr;
+            auto ast = newNode<AstStatement>();
+            ast->type = AstType::AST_GOTO;
+            ast->astGoto = res;
+            return ast;
+        }
+        if (tokens[cur].typ == TokenType::TT_PRINT)
+        {
+            auto res = parsePrint();
+            if (res == nullptr)
+                return nullptr;
+            auto ast = newNode<AstStatement>();
+            ast->type = AstType::AST_PRINT;
+            ast->astPrint = res;
+            return ast;
+        }
+        // something went wrong, unexprected token
+        return unexpectedError(tokens[cur]);
+    }
+
+    // everything of an if up to its body, which parseStatement() fills in
+    SWEET_CONSTEXPR AstIf *parseIf()
+    {
+        auto ifToken = tokens[cur++];
+
+        if (cur >= tokens.size())
+            return eofError(tokens.back(), "(");
+        if (tokens[cur].typ != TokenType::TT_LPAREN)
+            return unexpectedError(tokens[cur], "(");
+        auto lParenToken = tokens[cur++];
+
+        auto astExpression = parseExpression();
+        if (astExpression == nullptr)
+            return nullptr;
+
+        if (cur >= tokens.size() || tokens[cur].typ != TokenType::TT_RPAREN)
+        {
+            delete astExpression;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), ")");
+            return unexpectedError(tokens[cur], ")");
+        }
+        auto rParenToken = tokens[cur++];
+
+        auto res = newNode<AstIf>();
+        res->tokenIf = ifToken;
+        res->tokenLParen = lParenToken;
+        res->astExpression = astExpression;
+        res->tokenRParen = rParenToken;
+        res->astStatement = nullptr;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstPrint *parsePrint()
+    {
+        auto printToken = tokens[cur++];
+        auto astExpression = parseExpression();
+        if (astExpression == nullptr)
+            return nullptr;
+
+        if (cur >= tokens.size() ||
+            tokens[cur].typ != TokenType::TT_SEMI_COLON)
+        {
+            delete astExpression;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), ";");
+            return unexpectedError(tokens[cur], ";");
+        }
+        auto semiColonToken = tokens[cur++];
+
+        auto res = newNode<AstPrint>();
+        res->tokenPrint = printToken;
+        res->astExpression = astExpression;
+        res->tokenSemiColon = semiColonToken;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstLabel *parseLabel()
+    {
+        auto labelToken = tokens[cur++];
+        auto astVariable = parseVariable();
+        if (astVariable == nullptr)
+            return nullptr;
+        if (cur >= tokens.size() ||
+            tokens[cur].typ != TokenType::TT_SEMI_COLON)
+        {
+            delete astVariable;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), ";");
+            return unexpectedError(tokens[cur], ";");
+        }
+        auto semiColonToken = tokens[cur++];
+        auto res = newNode<AstLabel>();
+        res->tokenLabel = labelToken;
+        res->astVariable = astVariable;
+        res->tokenSemiColon = semiColonToken;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstGoto *parseGoto()
+    {
+        auto gotoToken = tokens[cur++];
+        auto astVariable = parseVariable();
+        if (astVariable == nullptr)
+            return nullptr;
+        if (cur >= tokens.size() ||
+            tokens[cur].typ != TokenType::TT_SEMI_COLON)
+        {
+            delete astVariable;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), ";");
+            return unexpectedError(tokens[cur], ";");
+        }
+        auto semiColonToken = tokens[cur++];
+        auto res = newNode<AstGoto>();
+        res->tokenGoto = gotoToken;
+        res->astVariable = astVariable;
+        res->tokenSemiColon = semiColonToken;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstVariable *parseVariable()
+    {
+        if (cur >= tokens.size())
+            return eofError(tokens.back(), "variable");
+        if (tokens[cur].typ != TokenType::TT_VARIABLE)
+            return unexpectedError(tokens[cur], "variable");
+        auto res = newNode<AstVariable>();
+        res->tokenVariable = tokens[cur++];
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstAssign *parseAssign()
+    {
+        auto astVariable = parseVariable();
+        if (astVariable == nullptr)
+            return nullptr;
+
+        if (cur >= tokens.size() || tokens[cur].typ != TokenType::TT_EQUAL)
+        {
+            delete astVariable;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), "=");
+            return unexpectedError(tokens[cur], "=");
+        }
+        auto equalToken = tokens[cur++];
+
+        auto astExpression = parseExpression();
+        if (astExpression == nullptr)
+        {
+            delete astVariable;
+            return nullptr;
+        }
+
+        if (cur >= tokens.size() ||
+            tokens[cur].typ != TokenType::TT_SEMI_COLON)
+        {
+            delete astVariable;
+            delete astExpression;
+            if (cur >= tokens.size())
+                return eofError(tokens.back(), ";");
+            return unexpectedError(tokens[cur], ";");
+        }
+        auto semiColonToken = tokens[cur++];
+
+        auto res = newNode<AstAssign>();
+        res->astVariable = astVariable;
+        res->tokenEqual = equalToken;
+        res->astExpression = astExpression;
+        res->tokenSemiColon = semiColonToken;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstExpression *parseExpression()
+    {
+        auto left = parsePrimary();
+        if (left == nullptr)
+            return nullptr;
+
+        // check if the operator exists
+        if (cur >= tokens.size())
+        {
+            delete left;
+            return eofError(tokens.back(), ";");
+        }
+        if (!isOperator(tokens[cur].typ))
+        {
+            auto res = newNode<AstExpression>();
+            res->left = left;
+            res->right = nullptr;
+            return res;
+        }
+        auto op = tokens[cur++];
+
+        auto right = parsePrimary();
+        if (right == nullptr)
+        {
+            delete left;
+            return nullptr;
+        }
+
+        auto res = newNode<AstExpression>();
+        res->left = left;
+        res->right = right;
+        res->tokenOperator = op;
+        return res;
+    }
+
+    SWEET_CONSTEXPR AstPrimary *parsePrimary()
+    {
+        if (cur >= tokens.size())
+            return eofError(tokens.back(), "primary");
+        if (tokens[cur].typ == TokenType::TT_VARIABLE)
+        {
+            auto astVariable = parseVariable();
+            if (astVariable == nullptr)
+                return nullptr;
+            auto res = newNode<AstPrimary>();
+            res->type = AstType::AST_VARIABLE;
+            res->astVariable = astVariable;
+            return res;
+        }
+        if (tokens[cur].typ == TokenType::TT_LITERAL)
+        {
+            auto astLiteral = parseLiteral();
+            if (astLiteral == nullptr)
+                return nullptr;
+            auto res = newNode<AstPrimary>();
+            res->type = AstType::AST_LITERAL;
+            res->astLiteral = astLiteral;
+            return res;
+        }
+        // something went wrong, unexprected token
+        return unexpectedError(tokens[cur]);
+    }
+
+    SWEET_CONSTEXPR AstLiteral *parseLiteral()
+    {
+        if (cur >= tokens.size())
+            return eofError(tokens.back(), "literal");
+        if (tokens[cur].typ != TokenType::TT_LITERAL)
+            return unexpectedError(tokens[cur], "literal");
+        auto res = newNode<AstLiteral>();
+        res->tokenLiteral = tokens[cur++];
+        return res;
+    }
+
+    // helper functions
+
+    SWEET_CONSTEXPR std::nullptr_t eofError(Token token, std::string expected)
+    {
+        std::string details =
+            "expected '" + expected + "', instead reached eof.";
+        auto error = Error(ErrorType::EOF_ERROR, details,
+                           token.startPos, token.endPos);
+        MemoryScope scope("Error");
+        errors.push_back(error);
+        return nullptr;
+    }
+
+    SWEET_CONSTEXPR std::nullptr_t unexpectedError(Token token,
+                                                   std::string expected = "")
+    {
+        std::string details = "unexpected token '" + token.lex + "' found";
+        if (expected != "")
+            details += ", was expecting '" + expected + "'.";
+        auto error = Error(ErrorType::UNEXPECTED_TOKEN_ERROR, details,
+                           token.startPos, token.endPos);
+        MemoryScope scope("Error");
+        errors.push_back(error);
+        return nullptr;
+    }
+};
+
+} // namespace sweet
+
+#endif
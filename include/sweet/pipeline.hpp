@@ -0,0 +1,43 @@
+#ifndef SWEET_PIPELINE_HPP
+#define SWEET_PIPELINE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Pipeline
+// ==================================================
+
+struct PipelineOptions
+{
+    std::int64_t fuel = -1; // backward jumps the whole run may take, -1 for
+                            // no limit
+};
+
+struct PipelineResult
+{
+    RunStatus status = RunStatus::FINISHED; // SUSPENDED when out of fuel
+    std::vector<Error> errors;
+};
+
+// reads a program from `input` and runs each statement as soon as its ';'
+// has been read, unoptimized, with `out` flushed whenever the input has to
+// be waited for. A goto to a label still to come stops the run until the
+// label has been read. Code nothing can jump back into is dropped, so as long
+// as the program has no labels it runs in constant memory however long it
+// is; the code from the first label on is kept
+PipelineResult runPipeline(int input, const std::string &inputName,
+                           std::ostream &out,
+                           const PipelineOptions &options = PipelineOptions());
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SWEET_POSITION_HPP
+#define SWEET_POSITION_HPP
+
+#include <ostream>
+#include <string>
+
+#include "sweet/memory.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Position
+// ==================================================
+
+struct Position
+{
+    std::string fname; // name of the file
+    int idx, ln, col;  // current index, line number and column number
+
+    SWEET_CONSTEXPR Position()
+        : fname{"<stdin>"}, idx{0}, ln{1}, col{1} {}
+    SWEET_CONSTEXPR Position(std::string filename)
+        : fname{filename}, idx{0}, ln{1}, col{1} {}
+    SWEET_CONSTEXPR Position(std::string filename, int index, int line,
+                             int column)
+        : fname{filename}, idx{index}, ln{line}, col{column} {}
+
+    // move past the character `c`, which is the one at the current index
+    SWEET_CONSTEXPR void advance(char c)
+    {
+        if (c == '\n')
+        {
+            ln++;
+            col = 0;
+        }
+        idx++;
+        col++;
+    }
+
+    SWEET_CONSTEXPR void reset()
+    {
+        idx = 0;
+        ln = 1;
+        col = 1;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &out, const Position &pos)
+{
+    out << pos.fname << ":" << pos.ln << ":" << pos.col;
+    return out;
+}
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SWEET_PRINTER_HPP
+#define SWEET_PRINTER_HPP
+
+#include <ostream>
+#include <string>
+
+#include "sweet/ast.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Print AST
+// ==================================================
+
+void printAstVariable(std::ostream &out, AstVariable *variable,
+                      std::string prefix);
+void printAstLiteral(std::ostream &out, AstLiteral *literal,
+                     std::string prefix);
+void printAstPrimary(std::ostream &out, AstPrimary *primary,
+                     std::string prefix);
+void printAstExpression(std::ostream &out, AstExpression *expression,
+                        std::string prefix);
+void printAstGoto(std::ostream &out, AstGoto *astGoto, std::string prefix);
+void printAstLabel(std::ostream &out, AstLabel *label, std::string prefix);
+void printAstPrint(std::ostream &out, AstPrint *print, std::string prefix);
+void printAstAssign(std::ostream &out, AstAssign *assign, std::string prefix);
+void printAstIf(std::ostream &out, AstIf *astIf, std::string prefix);
+void printAstStatement(std::ostream &out, AstStatement *statement,
+                       std::string prefix);
+void printAstProgram(std::ostream &out, AstProgram *program,
+                     std::string prefix = "");
+
+} // namespace sweet
+
+#endif
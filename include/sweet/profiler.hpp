@@ -0,0 +1,129 @@
+#ifndef SWEET_PROFILER_HPP
+#define SWEET_PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "sweet/error.hpp"
+#include "sweet/program.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Profiler
+// ==================================================
+
+// cheapest monotonic clock there is, only differences between two readings
+// mean anything
+inline std::uint64_t clockTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// raw counters of a profiled run, indexed by instruction; executions are
+// counted exactly while time is sampled, one instruction out of roughly
+// every `period` being timed
+struct Profile
+{
+    Profile(const Program &program, int period = 64);
+
+    std::vector<std::uint64_t> counts; // times each instruction ran
+    std::vector<std::uint64_t> jumps;  // times each instruction jumped
+    std::vector<std::uint64_t> ticks;  // sampled clock ticks per instruction
+    std::vector<std::uint64_t> samples; // times each instruction was timed
+    int period;
+    std::uint64_t overhead; // ticks it takes to read the clock twice
+    std::uint64_t totalNs = 0; // wall time of the profiled runs
+    std::uint64_t countdown = 1; // dispatches left until the next sample
+    std::uint64_t seed = 0x9e3779b97f4a7c15;
+};
+
+// like run(context), but counts into `profile`; a profile may collect the
+// counts of several runs of the same program. Statements the optimizer
+// folded into an OP_LOOP or removed are not counted, so only an unoptimized
+// program has counts for all of them
+RunResult run(Context &context, Profile &profile);
+// both at once, charging `fuel` the way run(context, fuel) does; -1 for no
+// limit
+RunResult run(Context &context, Profile &profile, std::int64_t fuel);
+
+struct StatementProfile
+{
+    int stmt;            // index into Program::statements
+    std::uint64_t count; // times the statement ran
+    double ns;           // estimated time spent in the statement itself
+    std::uint64_t taken, notTaken; // outcomes of an if
+};
+
+// one entry for every statement that ran, the most expensive first
+std::vector<StatementProfile> summarize(const Program &program,
+                                        const Profile &profile);
+
+void printProfile(std::ostream &out, const Program &program,
+                  const Profile &profile);
+// "file;file:line:col kind nanoseconds" lines for flame graph tools
+void printProfileFolded(std::ostream &out, const Program &program,
+                        const Profile &profile);
+void printProfileJson(std::ostream &out, const Program &program,
+                      const Profile &profile);
+
+// ==================================================
+// Source profile
+// ==================================================
+
+// what profiled runs saw of a statement
+struct StatementCounts
+{
+    AstType type;
+    std::uint64_t count;           // times it ran
+    std::uint64_t taken, notTaken; // outcomes of an if
+};
+
+// the counts of every statement that ran, by the line and column it starts
+// at, so that they still apply once the source is compiled again
+struct SourceProfile
+{
+    std::map<std::pair<int, int>, StatementCounts> statements;
+
+    // counts of the statement `info` describes, null when none of that kind
+    // ran where it starts
+    const StatementCounts *find(const StatementInfo &info) const;
+    // times the branch of the if `info` describes jumped
+    std::uint64_t jumps(const StatementInfo &info) const;
+};
+
+struct SourceProfileResult
+{
+    SourceProfile value;
+    std::vector<Error> errors;
+};
+
+SourceProfile sourceProfile(const Program &program, const Profile &profile);
+
+// one line per statement, with the outcomes of ifs at the end:
+//
+//     # kind line column count [taken not-taken]
+//     if 3 1 11 10 1
+//     goto 4 1 10
+void writeSourceProfile(std::ostream &out, const SourceProfile &profile);
+SourceProfileResult readSourceProfile(const std::string &filename,
+                                      const std::string &source);
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef SWEET_PROGRAM_HPP
+#define SWEET_PROGRAM_HPP
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sweet/ast.hpp"
+#include "sweet/error.hpp"
+#include "sweet/position.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Program
+// ==================================================
+
+typedef std::int64_t Value;
+
+enum struct OpCode
+{
+    OP_MOVE, // dst = a
+
+    OP_ADD, // dst = a + b
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_ADD_UNCHECKED, // dst = a + b, wrapping around where it is known
+    OP_SUB_UNCHECKED, // not to overflow
+    OP_MUL_UNCHECKED,
+    OP_DIV_UNCHECKED, // dst = a / b where it is known not to fail
+    OP_EQ, // dst = a == b
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+
+    OP_PRINT, // print a
+
+    OP_JUMP,    // goto target
+    OP_JUMP_EQ, // if (a == b) goto target
+    OP_JUMP_NE,
+    OP_JUMP_LT,
+    OP_JUMP_LE,
+    OP_JUMP_GT,
+    OP_JUMP_GE,
+    OP_LOOP, // run Program::loops[a] in one go and goto target, or fall
+             // through when that is not possible
+
+    OP_HALT,
+};
+
+const char *opCodeName(OpCode op);
+
+// conditional and unconditional jumps, OP_LOOP included
+bool isJump(OpCode op);
+// jumps that compare a and b to decide whether to fall through
+bool isBranch(OpCode op);
+// the branch that jumps exactly when `op` falls through
+OpCode negatedBranch(OpCode op);
+// dst = a op b
+bool isBinary(OpCode op);
+
+// every operand is a slot, constants live in slots of their own past the
+// variables so that the interpreter never has to tell the two apart
+struct Instruction
+{
+    OpCode op;
+    int dst;    // destination slot
+    int a, b;   // operand slots
+    int target; // instruction index to jump to
+    int stmt;   // index into Program::statements it was compiled from
+};
+
+struct StatementInfo
+{
+    AstType type;
+    Position startPos, endPos;
+    int body = -1; // statement an if runs, -1 when it is a goto folded into
+                   // the if's own jump
+    bool inverted = false; // the if's jump was turned around, so that it
+                           // jumps to `body` or falls through to the label
+};
+
+const char *statementName(AstType type);
+
+// v = v + step, or v = v - step when `negate`, once per iteration
+struct LinearVariable
+{
+    int slot;
+    int step; // constant or a variable the loop does not write
+    bool negate;
+};
+
+// v = v + term, or v = v - term when `negate`, once per iteration
+struct SumVariable
+{
+    int slot;
+    int term;   // index into Loop::linear
+    bool after; // term is read after it is stepped in the same iteration
+    bool negate;
+};
+
+// v = linear * factor, kept up to date by adding the product of the factor
+// and the step instead
+struct ReducedProduct
+{
+    int slot;
+    int linear; // index into Loop::linear, whose step is a constant
+    Value factor;
+    bool after; // as for SumVariable
+};
+
+// a loop made of straight line code closed by a conditional jump back to
+// its first instruction, that can tell how often it will run from the values
+// its variables have when it is entered
+struct Loop
+{
+    std::vector<LinearVariable> linear;
+    std::vector<SumVariable> sums;
+    std::vector<ReducedProduct> products;
+    int counter; // index into `linear` of the variable the loop tests
+    OpCode test; // the loop goes on while `counter test bound` holds
+    int bound;   // constant or a variable the loop does not write
+    // the loop is replaced by the final values of its variables, otherwise
+    // OP_LOOP only checks that the reduced copy it jumps to can not
+    // overflow and sets up its products
+    bool closed;
+};
+
+struct Program
+{
+    std::vector<Instruction> code;
+    std::vector<std::string> names; // names of the non constant slots
+    std::vector<Value> constants;   // values of the slots after `names`
+    std::vector<StatementInfo> statements;
+    std::unordered_map<std::string, int> slotIndex; // variable name to slot
+    std::vector<Loop> loops;
+
+    int slotCount() const { return names.size() + constants.size(); }
+    int constantBase() const { return names.size(); }
+    bool isConstant(int slot) const { return slot >= constantBase(); }
+    Value constantValue(int slot) const
+    {
+        return constants[slot - constantBase()];
+    }
+
+    // slot of the variable `name`, -1 when the program never uses it
+    int slotOf(const std::string &name) const
+    {
+        auto it = slotIndex.find(name);
+        return it == slotIndex.end() ? -1 : it->second;
+    }
+};
+
+// slot written by `ins`, -1 when it writes none
+int definedSlot(const Instruction &ins);
+// slots read by `ins` go into `used`, returns how many there are
+int usedSlots(const Instruction &ins, int used[2]);
+// false when `ins` can not stop the program with a runtime error
+bool canTrap(const Program &program, const Instruction &ins);
+
+// runs `loop` from the values in `slots` if that takes at most `maxTrips`
+// iterations and nothing overflows, returning the number of iterations; -1
+// when it could not, in which case `slots` is left as it was
+std::int64_t runLoop(const Program &program, const Loop &loop, Value *slots,
+                     std::int64_t maxTrips);
+
+void printProgram(std::ostream &out, const Program &program);
+
+// ==================================================
+// Compiler
+// ==================================================
+
+struct CompilerResult
+{
+    std::shared_ptr<const Program> value = nullptr;
+    std::vector<Error> errors;
+    std::vector<Remark> remarks;
+};
+
+struct CompileOptions
+{
+    // run the optimizer, which keeps the output of the program but not the
+    // final values of its variables
+    bool optimize = false;
+};
+
+struct Compiler
+{
+    Compiler(AstProgram *program) : ast{program} {}
+
+    CompilerResult compile();
+
+    // compiles a program while the rest of it is still being read, appending
+    // one statement at a time to `current()`, whose code always ends in the
+    // OP_HALT a run stops at when it gets to what has not been read yet.
+    // Constants get slots among the variables, named after their value,
+    // since the number of variables is never final
+    Compiler();
+
+    Program &current() { return *program; }
+
+    // compiles `statement` in front of the final OP_HALT. A goto whose label
+    // has not been seen yet jumps to an OP_HALT of its own until it is
+    std::vector<Error> append(AstStatement *statement);
+
+    // the label a run that stopped at `pc` waits for, null when it stopped
+    // at the end of the code
+    const std::string *waitsFor(int pc) const;
+
+    // where the label `name` is, -1 when it has not been seen yet
+    int labelAt(const std::string &name) const;
+    bool hasLabels() const { return !labels.empty(); }
+
+    // slots given to constants since the last call, with their values
+    std::vector<std::pair<int, Value>> takeLiterals();
+
+    // drops all the code compiled so far, which nothing can jump back into
+    // as long as no label has been seen, freeing the slots of its constants
+    void forget();
+
+    // errors for the gotos whose label never came
+    std::vector<Error> unresolved() const;
+
+private:
+    // a label gotos wait for while the program is being read
+    struct Pending
+    {
+        Token token;            // the first goto to it
+        std::vector<int> jumps; // to patch once it comes
+        int trap = -1;          // the OP_HALT the jumps go to until then
+    };
+
+    AstProgram *ast;
+    std::shared_ptr<Program> program;
+    std::unordered_map<Value, int> constantIndex;
+    std::unordered_map<std::string, int> labels;
+    std::vector<std::pair<int, Token>> gotos; // unresolved jumps
+    int temp = -1;
+    int stmt = 0;
+    CompilerResult results;
+    bool appending = false;
+    std::unordered_map<std::string, Pending> pending;
+    std::vector<std::pair<int, Value>> literals;
+    std::vector<int> freeSlots; // of constants forgotten
+
+    void compileStatement(AstStatement *statement);
+    void compileAssign(AstAssign *astAssign);
+    void compileLabel(AstLabel *astLabel);
+    void compileGoto(AstGoto *astGoto);
+    void compilePrint(AstPrint *astPrint);
+
+    int compilePrimary(AstPrimary *primary);
+    void compileBranch(AstExpression *condition, bool jumpWhen, int target,
+                       const Token *label);
+    int variable(const std::string &name);
+    int constant(Value value);
+    int temporary();
+    int emit(OpCode op, int dst, int a, int b, int target = -1);
+};
+
+// lexes, parses, compiles and optionally optimizes `source` in one go
+CompilerResult compile(const std::string &filename, const std::string &source,
+                       const CompileOptions &options = CompileOptions());
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SWEET_RUNTIME_HPP
+#define SWEET_RUNTIME_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Runtime
+// ==================================================
+
+// everything a single execution of a program mutates; the program itself is
+// never written to, so any number of contexts may run it concurrently
+struct Context
+{
+    // `program` must outlive the context
+    Context(const Program &program, std::ostream &out = std::cout);
+
+    // forget the previous run, reusing the slots already allocated
+    void reset();
+
+    // value of the variable `name`, false when the program does not use it
+    bool get(const std::string &name, Value &value) const;
+    // set the variable `name` before a run, false when the program does not
+    // use it
+    bool set(const std::string &name, Value value);
+
+    const Program *program;
+    std::vector<Value> slots;
+    std::ostream *out;
+    int pc;
+};
+
+enum struct RunStatus
+{
+    FINISHED,
+    SUSPENDED,
+    ERROR,
+};
+
+struct RunResult
+{
+    RunStatus status;
+    Error error;       // set when status is ERROR
+    std::int64_t fuel; // fuel left over by a metered run
+};
+
+// runs the program from where the context left off until it halts or fails
+RunResult run(Context &context);
+// like run(context), but every backward jump taken costs one unit of `fuel`;
+// the run takes at most `fuel` of them and is SUSPENDED at the next, before
+// taking it. Running the context again resumes it exactly where it stopped,
+// with that jump the first one it pays for
+RunResult run(Context &context, std::int64_t fuel);
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SWEET_SCHEDULER_HPP
+#define SWEET_SCHEDULER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "sweet/program.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Scheduler
+// ==================================================
+
+// one suspended or running instance of a program
+struct Task
+{
+    Task(std::shared_ptr<const Program> program, std::ostream &out)
+        : program{program}, context{*program, out} {}
+
+    std::shared_ptr<const Program> program;
+    Context context;
+    std::int64_t limit = -1; // total fuel the task may use, -1 for no limit
+    std::int64_t used = 0;   // fuel used so far
+    RunResult result{RunStatus::SUSPENDED, Error(), 0};
+    // called on a worker thread once the task finishes, fails or reaches
+    // its limit, in which case result.status is still SUSPENDED
+    std::function<void(Task &)> done;
+};
+
+// multiplexes any number of tasks over a fixed set of worker threads; each
+// task runs for at most `slice` backward jumps before it goes to the back of
+// the queue, so a runaway script only ever delays the others by one slice
+struct Scheduler
+{
+    Scheduler(int workers, std::int64_t slice);
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    void submit(std::shared_ptr<Task> task);
+    // blocks until every submitted task is done
+    void wait();
+
+private:
+    std::int64_t slice;
+    std::vector<std::thread> threads;
+    std::deque<std::shared_ptr<Task>> queue;
+    std::mutex mutex;
+    std::condition_variable ready, idle;
+    int pending = 0;
+    bool stopping = false;
+
+    void work();
+};
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SWEET_SERVE_HPP
+#define SWEET_SERVE_HPP
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sweet
+{
+
+// ==================================================
+// Serve
+// ==================================================
+
+// answers one request: the command line arguments and the source the client
+// sent, with what should reach its stdout and stderr written to `out` and
+// `err`; returns the status the client exits with
+typedef std::function<int(const std::vector<std::string> &args,
+                          const std::string &source, std::ostream &out,
+                          std::ostream &err)>
+    ServeHandler;
+
+// whether the sweet option `arg` takes the argument after it as its value;
+// sweet and sweetc both go by it, so that sweetc never takes a value for
+// the file name
+bool optionTakesValue(const std::string &arg);
+
+// $XDG_RUNTIME_DIR/sweet.sock, or /tmp/sweet-<uid>.sock without one
+std::string defaultSocketPath();
+
+// listens on the Unix socket at `path` and answers every connection with
+// `handler`, on `workers` threads; never returns unless the socket can not
+// be set up, and then returns why. SIGINT and SIGTERM remove the socket and
+// exit
+std::string serve(const std::string &path, int workers,
+                  const ServeHandler &handler);
+
+// sends `args` and `source` to the daemon at `path`, writing what it sends
+// back to `outFd` and `errFd` as it arrives; returns the status the daemon
+// answered with, or -1 with `error` set when it could not be reached
+int requestServe(const std::string &path, const std::vector<std::string> &args,
+                 const std::string &source, int outFd, int errFd,
+                 std::string &error);
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SWEET_STREAM_HPP
+#define SWEET_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sweet/error.hpp"
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Stream
+// ==================================================
+
+struct StreamOptions
+{
+    // threads running records, 0 for one per core the reader and the writer
+    // leave over
+    int workers = 0;
+    // bytes of input a worker takes at a time, rounded up to whole records
+    std::size_t blockBytes = 1 << 20;
+};
+
+struct StreamStats
+{
+    std::int64_t records = 0; // records read
+    std::int64_t failed = 0;  // records that were malformed or failed to run
+    std::int64_t bytesIn = 0;
+    std::int64_t bytesOut = 0;
+    double seconds = 0;
+};
+
+struct StreamResult
+{
+    StreamStats value;
+    std::vector<Error> errors; // reasons nothing could be run at all
+};
+
+// runs `program` once per record read from the file descriptor `input`,
+// whose first line names the variables the fields of every following line
+// are bound to:
+//
+//     a, b
+//     1, 2
+//     3, 4
+//
+// Fields are separated by commas and/or blanks and empty lines are skipped.
+// Every run starts from zero in the variables without a field, and what it
+// prints goes to `output` in the order of the records. A record that is
+// malformed or fails to run has its error written to `errors` and the stream
+// carries on. Regular files are mapped into memory, anything else is read as
+// it comes. Reading, running and writing happen on threads of their own,
+// with the records split into blocks among the workers
+StreamResult runStream(const Program &program, int input,
+                       const std::string &inputName, int output, int errors,
+                       const StreamOptions &options = StreamOptions());
+
+} // namespace sweet
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SWEET_TIER_HPP
+#define SWEET_TIER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+#include "sweet/position.hpp"
+#include "sweet/program.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Tiered execution
+// ==================================================
+
+struct TierOptions
+{
+    // backward jumps into the top of one loop before the program is
+    // optimized to carry on from there
+    std::int64_t threshold = 1000;
+    // backward jumps run between looks at which loop the run is in. The
+    // whole slice is counted against that loop
+    std::int64_t slice = 100;
+    // backward jumps the whole run may take, -1 for no limit; a run that
+    // needs more ends SUSPENDED
+    std::int64_t fuel = -1;
+    // asked every so many backward jumps, the run ends SUSPENDED once it
+    // returns true
+    std::function<bool()> cancelled;
+};
+
+struct TierStats
+{
+    std::int64_t baselineJumps = 0; // backward jumps taken before tiering up
+    std::int64_t baselineNs = 0;
+    bool tieredUp = false;
+    Position loop;               // top of the loop that got hot
+    std::int64_t loopJumps = 0;  // backward jumps counted into it
+    std::int64_t optimizeNs = 0;
+    std::int64_t optimizedNs = 0;
+    int instructions[2] = {0, 0}; // in the baseline and the optimized code
+};
+
+// runs `program`, compiled without optimizing, until a loop in it gets hot.
+// The program is then optimized to start at the top of that loop and the run
+// carries on in the optimized code with the variables it had, so a short
+// run never waits for the optimizer and a long one still gets its code
+RunResult runTiered(const Program &program, std::ostream &out,
+                    const TierOptions &options, TierStats &stats);
+
+void printTierStats(std::ostream &out, const TierStats &stats);
+
+} // namespace sweet
+
+#endif
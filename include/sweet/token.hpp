@@ -0,0 +1,178 @@
+#ifndef SWEET_TOKEN_HPP
+#define SWEET_TOKEN_HPP
+
+#include <ostream>
+#include <string>
+
+#include "sweet/position.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Token
+// ==================================================
+
+enum struct TokenType
+{
+    TT_LITERAL,
+    TT_VARIABLE,
+
+    TT_PRINT,
+    TT_GOTO,
+    TT_IF,
+    TT_LABEL,
+
+    TT_EQUAL,
+    TT_SEMI_COLON,
+    TT_LPAREN,
+    TT_RPAREN,
+
+    TT_EQUAL_EQUAL,
+    TT_LESS,
+    TT_LESS_EQUAL,
+    TT_GREATER,
+    TT_GREATER_EQUAL,
+    TT_PLUS,
+    TT_MINUS,
+    TT_MULTIPLY,
+    TT_DIVIDE,
+};
+
+constexpr const char *tokenTypeName(TokenType type)
+{
+    switch (type)
+    {
+    case TokenType::TT_LITERAL:
+        return "TT_LITERAL";
+    case TokenType::TT_VARIABLE:
+        return "TT_VARIABLE";
+    case TokenType::TT_PRINT:
+        return "TT_PRINT";
+    case TokenType::TT_GOTO:
+        return "TT_GOTO";
+    case TokenType::TT_IF:
+        return "TT_IF";
+    case TokenType::TT_LABEL:
+        return "TT_LABEL";
+    case TokenType::TT_EQUAL:
+        return "TT_EQUAL";
+    case TokenType::TT_SEMI_COLON:
+        return "TT_SEMI_COLON";
+    case TokenType::TT_LPAREN:
+        return "TT_LPAREN";
+    case TokenType::TT_RPAREN:
+        return "TT_RPAREN";
+    case TokenType::TT_EQUAL_EQUAL:
+        return "TT_EQUAL_EQUAL";
+    case TokenType::TT_LESS:
+        return "TT_LESS";
+    case TokenType::TT_LESS_EQUAL:
+        return "TT_LESS_EQUAL";
+    case TokenType::TT_GREATER:
+        return "TT_GREATER";
+    case TokenType::TT_GREATER_EQUAL:
+        return "TT_GREATER_EQUAL";
+    case TokenType::TT_PLUS:
+        return "TT_PLUS";
+    case TokenType::TT_MINUS:
+        return "TT_MINUS";
+    case TokenType::TT_MULTIPLY:
+        return "TT_MULTIPLY";
+    case TokenType::TT_DIVIDE:
+        return "TT_DIVIDE";
+    }
+    return "TT_UNKNOWN";
+}
+
+inline std::ostream &operator<<(std::ostream &out, TokenType type)
+{
+    out << tokenTypeName(type);
+    return out;
+}
+
+// keywords are lexed as variables first, this maps them to their own type
+SWEET_CONSTEXPR inline TokenType keywordType(const std::string &lexical)
+{
+    if (lexical == "print")
+        return TokenType::TT_PRINT;
+    if (lexical == "goto")
+        return TokenType::TT_GOTO;
+    if (lexical == "if")
+        return TokenType::TT_IF;
+    if (lexical == "label")
+        return TokenType::TT_LABEL;
+    return TokenType::TT_VARIABLE;
+}
+
+// `lexical` must be one of the symbols accepted by the lexer
+SWEET_CONSTEXPR inline TokenType symbolType(const std::string &lexical)
+{
+    if (lexical == "=")
+        return TokenType::TT_EQUAL;
+    if (lexical == ";")
+        return TokenType::TT_SEMI_COLON;
+    if (lexical == "(")
+        return TokenType::TT_LPAREN;
+    if (lexical == ")")
+        return TokenType::TT_RPAREN;
+    if (lexical == "==")
+        return TokenType::TT_EQUAL_EQUAL;
+    if (lexical == "<")
+        return TokenType::TT_LESS;
+    if (lexical == "<=")
+        return TokenType::TT_LESS_EQUAL;
+    if (lexical == ">")
+        return TokenType::TT_GREATER;
+    if (lexical == ">=")
+        return TokenType::TT_GREATER_EQUAL;
+    if (lexical == "+")
+        return TokenType::TT_PLUS;
+    if (lexical == "-")
+        return TokenType::TT_MINUS;
+    if (lexical == "*")
+        return TokenType::TT_MULTIPLY;
+    return TokenType::TT_DIVIDE;
+}
+
+constexpr bool isOperator(TokenType type)
+{
+    switch (type)
+    {
+    case TokenType::TT_EQUAL_EQUAL:
+    case TokenType::TT_LESS:
+    case TokenType::TT_LESS_EQUAL:
+    case TokenType::TT_GREATER:
+    case TokenType::TT_GREATER_EQUAL:
+    case TokenType::TT_PLUS:
+    case TokenType::TT_MINUS:
+    case TokenType::TT_MULTIPLY:
+    case TokenType::TT_DIVIDE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct Token
+{
+    TokenType typ;
+    std::string lex;
+    Position startPos, endPos;
+
+    SWEET_CONSTEXPR Token() {}
+    SWEET_CONSTEXPR Token(TokenType type, std::string lexical, Position start,
+                          Position end)
+        : typ{type}, lex{lexical}, startPos{start}, endPos{end} {}
+};
+
+inline std::ostream &operator<<(std::ostream &out, const Token &token)
+{
+    out << token.typ << " '" << token.lex << "' "
+        << token.startPos << " " << token.endPos;
+    return out;
+}
+
+} // namespace sweet
+
+#endif
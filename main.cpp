@@ -1,1079 +1,873 @@
-#include <map>
-#include <vector>
-#include <memory>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <iostream>
-using namespace std;
-
-// ==================================================
-// Position
-// ==================================================
-
-static string EMPTY_STRING = "";
-
-struct Position
-{
-    string fname;     // name of the file
-    string &src;      // content of the file
-    int idx, ln, col; // current index, line number and column number
-
-    Position()
-        : fname{"<stdin>"}, src{EMPTY_STRING}, idx{0}, ln{1}, col{1} {}
-    Position(string filename, string &source)
-        : fname{filename}, src{source}, idx{0}, ln{1}, col{1} {}
-    Position(string filename, string &source, int index, int line, int column)
-        : fname{filename}, src{source}, idx{index}, ln{line}, col{column} {}
-
-    void operator=(const Position &pos)
-    {
-        fname = pos.fname;
-        src = pos.src;
-        idx = pos.idx;
-        ln = pos.ln;
-        col = pos.col;
-    }
-
-    void advance()
-    {
-        if (idx >= src.size())
-            return;
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-        if (src[idx] == '\n')
-        {
-            ln++;
-            col = 0;
-        }
-        idx++;
-        col++;
-    }
+#include <fcntl.h>
+#include <unistd.h>
 
-    char getChar()
-    {
-        if (idx >= src.size())
-            return 0;
-        return src[idx];
-    }
+#include "sweet.hpp"
+using namespace std;
+using namespace sweet;
 
-    void reset()
-    {
-        idx = 0;
-        ln = 1;
-        col = 1;
-    }
-};
+// --mem-stats has to see every allocation, which only the executable can do
+// by replacing the global operator new and delete
 
-ostream &operator<<(ostream &out, const Position &pos)
+void *operator new(size_t size)
 {
-    out << pos.fname << ":" << pos.ln << ":" << pos.col;
-    return out;
+    void *block = malloc(size ? size : 1);
+    if (!block)
+        throw bad_alloc();
+    if (memoryTracking())
+        recordAllocation(block, size);
+    return block;
 }
 
-// ==================================================
-// Token
-// ==================================================
-
-enum struct TokenType
-{
-    TT_LITERAL,
-    TT_VARIABLE,
-
-    TT_PRINT,
-    TT_GOTO,
-    TT_IF,
-    TT_LABEL,
-
-    TT_EQUAL,
-    TT_SEMI_COLON,
-    TT_LPAREN,
-    TT_RPAREN,
-
-    TT_EQUAL_EQUAL,
-    TT_LESS,
-    TT_LESS_EQUAL,
-    TT_GREATER,
-    TT_GREATER_EQUAL,
-    TT_PLUS,
-    TT_MINUS,
-    TT_MULTIPLY,
-    TT_DIVIDE,
-};
-
-ostream &operator<<(ostream &out, TokenType type)
+void operator delete(void *block) noexcept
 {
-    static const map<TokenType, string> TokenTypeToString = {
-        {TokenType::TT_LITERAL, "TT_LITERAL"},
-        {TokenType::TT_VARIABLE, "TT_VARIABLE"},
-        {TokenType::TT_PRINT, "TT_PRINT"},
-        {TokenType::TT_GOTO, "TT_GOTO"},
-        {TokenType::TT_IF, "TT_IF"},
-        {TokenType::TT_LABEL, "TT_LABEL"},
-        {TokenType::TT_EQUAL, "TT_EQUAL"},
-        {TokenType::TT_SEMI_COLON, "TT_SEMI_COLON"},
-        {TokenType::TT_LPAREN, "TT_LPAREN"},
-        {TokenType::TT_RPAREN, "TT_RPAREN"},
-        {TokenType::TT_EQUAL_EQUAL, "TT_EQUAL_EQUAL"},
-        {TokenType::TT_LESS, "TT_LESS"},
-        {TokenType::TT_LESS_EQUAL, "TT_LESS_EQUAL"},
-        {TokenType::TT_GREATER, "TT_GREATER"},
-        {TokenType::TT_GREATER_EQUAL, "TT_GREATER_EQUAL"},
-        {TokenType::TT_PLUS, "TT_PLUS"},
-        {TokenType::TT_MINUS, "TT_MINUS"},
-        {TokenType::TT_MULTIPLY, "TT_MULTIPLY"},
-        {TokenType::TT_DIVIDE, "TT_DIVIDE"},
-    };
-    out << TokenTypeToString.at(type);
-    return out;
-};
-
-static const map<string, TokenType> KEYWORDS = {
-    {"print", TokenType::TT_PRINT},
-    {"goto", TokenType::TT_GOTO},
-    {"if", TokenType::TT_IF},
-    {"label", TokenType::TT_LABEL},
-};
-
-static const map<string, TokenType> SYMBOLS = {
-    {"=", TokenType::TT_EQUAL},
-    {";", TokenType::TT_SEMI_COLON},
-    {"(", TokenType::TT_LPAREN},
-    {")", TokenType::TT_RPAREN},
-    {"==", TokenType::TT_EQUAL_EQUAL},
-    {"<", TokenType::TT_LESS},
-    {"<=", TokenType::TT_LESS_EQUAL},
-    {">", TokenType::TT_GREATER},
-    {">=", TokenType::TT_GREATER_EQUAL},
-    {"+", TokenType::TT_PLUS},
-    {"-", TokenType::TT_MINUS},
-    {"*", TokenType::TT_MULTIPLY},
-    {"/", TokenType::TT_DIVIDE},
-};
-
-static const map<string, TokenType> OPERATORS = {
-    {"==", TokenType::TT_EQUAL_EQUAL},
-    {"<", TokenType::TT_LESS},
-    {"<=", TokenType::TT_LESS_EQUAL},
-    {">", TokenType::TT_GREATER},
-    {">=", TokenType::TT_GREATER_EQUAL},
-    {"+", TokenType::TT_PLUS},
-    {"-", TokenType::TT_MINUS},
-    {"*", TokenType::TT_MULTIPLY},
-    {"/", TokenType::TT_DIVIDE},
-};
-
-struct Token
-{
-    TokenType typ;
-    string lex;
-    Position startPos, endPos;
-
-    Token() {}
-    Token(TokenType type, string lexical, Position start, Position end)
-        : typ{type}, lex{lexical}, startPos{start}, endPos{end} {}
-};
+    if (block && memoryTracking())
+        recordDeallocation(block);
+    free(block);
+}
 
-ostream &operator<<(ostream &out, const Token &token)
+void operator delete(void *block, size_t) noexcept
 {
-    out << token.typ << " '" << token.lex << "' "
-        << token.startPos << " " << token.endPos;
-    return out;
+    operator delete(block);
 }
 
-// ==================================================
-// Error
-// ==================================================
-
-enum struct ErrorType
+// reports the memory stats however main returns, after everything it owns
+// is gone so that the live bytes are the ones that leaked
+struct MemoryReport
 {
-    ILLEGAL_CHARACTER_ERROR,
-    UNEXPECTED_TOKEN_ERROR,
-    EOF_ERROR,
-    NO_ERROR,
-};
+    bool enabled = false;
 
-static const map<ErrorType, string> ERROR_NAME = {
-    {ErrorType::ILLEGAL_CHARACTER_ERROR, "IllegalCharacterError"},
-    {ErrorType::UNEXPECTED_TOKEN_ERROR, "UnexpectedTokenError"},
-    {ErrorType::EOF_ERROR, "EndOfFileError"},
-    {ErrorType::NO_ERROR, "NoError"},
+    ~MemoryReport()
+    {
+        if (!enabled)
+            return;
+        setMemoryTracking(false);
+        cout.flush();
+        printMemoryStats(cerr, memoryStats());
+    }
 };
 
-struct Error
+static bool readFile(const string &filename, string &source)
 {
-    ErrorType typ;             // error type
-    string deets;              // details regarding the error
-    Position startPos, endPos; // start and end positions
-
-    Error()
-        : typ{ErrorType::NO_ERROR} {}
-    Error(ErrorType type, string details, Position start, Position end)
-        : typ{type}, deets{details}, startPos{start}, endPos{end} {}
-
-    void operator=(const Error &error)
+    ifstream fs(filename);
+    if (!fs.good())
     {
-        typ = error.typ;
-        deets = error.deets;
-        startPos = error.startPos;
-        endPos = error.endPos;
+        cerr << "Error: no such file '" << filename << "' exists." << endl;
+        return false;
     }
-};
 
-ostream &operator<<(ostream &out, const Error &error)
-{
-    out << error.startPos << " " << ERROR_NAME.at(error.typ)
-        << ": " << error.deets;
-    return out;
+    string line;
+    while (getline(fs, line))
+    {
+        source += line + "\n";
+    }
+    fs.close();
+    return true;
 }
 
-// ==================================================
-// Lexer
-// ==================================================
-
-struct LexerResult
-{
-    vector<Token> value;
-    vector<Error> errors;
-};
-
-struct Lexer
+// runs the program once per row of the columns in `batchFile`, printing what
+// every row printed under a header of its own
+static int runBatch(const Program &program, const string &batchFile,
+                    bool simd)
 {
-    Lexer(string filename, string &source) : currentPos{filename, source} {}
-
-    LexerResult tokenize()
+    string source;
+    if (!readFile(batchFile, source))
+        return 1;
+    auto columnsResult = readColumns(batchFile, source);
+    if (columnsResult.errors.size())
     {
-        while (currentPos.idx < currentPos.src.size())
+        for (auto error : columnsResult.errors)
         {
-            getToken();
+            cerr << error << endl;
         }
-        return result;
+        return 1;
     }
-
-private:
-    LexerResult result;
-    Position currentPos;
-
-    void getToken()
+    for (auto &name : columnsResult.value.names)
     {
-        auto previousPos = currentPos;
-        // checking if whitespace
-        if (currentPos.src[currentPos.idx] == ' ' ||
-            currentPos.src[currentPos.idx] == '\n' ||
-            currentPos.src[currentPos.idx] == '\t')
-        {
-            currentPos.advance();
-        }
-        // checking if literal
-        else if (currentPos.idx < currentPos.src.size() &&
-                 isdigit(currentPos.src[currentPos.idx]))
-        {
-            string lexical = "";
-            while (currentPos.idx < currentPos.src.size() &&
-                   isdigit(currentPos.src[currentPos.idx]))
-            {
-                lexical.push_back(currentPos.src[currentPos.idx]);
-                currentPos.advance();
-            }
-            result.value.push_back(
-                Token(TokenType::TT_LITERAL, lexical, previousPos, currentPos));
-        }
-        // checking if variable
-        else if (currentPos.idx < currentPos.src.size() &&
-                 (isalpha(currentPos.src[currentPos.idx]) ||
-                  currentPos.src[currentPos.idx] == '_'))
-        {
-            string lexical = "";
-            while (currentPos.idx < currentPos.src.size() &&
-                   (isalpha(currentPos.src[currentPos.idx]) ||
-                    isdigit(currentPos.src[currentPos.idx]) ||
-                    currentPos.src[currentPos.idx] == '_'))
-            {
-
-                lexical.push_back(currentPos.src[currentPos.idx]);
-                currentPos.advance();
-            }
-            // check if the variable is a keyword
-            if (KEYWORDS.count(lexical))
-            {
-                result.value.push_back(Token(KEYWORDS.at(lexical), lexical,
-                                             previousPos, currentPos));
-            }
-            else
-            {
-                result.value.push_back(Token(TokenType::TT_VARIABLE, lexical,
-                                             previousPos, currentPos));
-            }
-        }
-        // checking if symbol
-        else if (
-            currentPos.src[currentPos.idx] == '=' ||
-            currentPos.src[currentPos.idx] == ';' ||
-            currentPos.src[currentPos.idx] == '(' ||
-            currentPos.src[currentPos.idx] == ')' ||
-            currentPos.src[currentPos.idx] == '<' ||
-            currentPos.src[currentPos.idx] == '>' ||
-            currentPos.src[currentPos.idx] == '+' ||
-            currentPos.src[currentPos.idx] == '-' ||
-            currentPos.src[currentPos.idx] == '*' ||
-            currentPos.src[currentPos.idx] == '/')
+        if (program.slotOf(name) < 0)
         {
-            string lexical = string(1, currentPos.src[currentPos.idx]);
-            currentPos.advance();
-            // checking if < or > or = follows by =
-            if ((lexical == "=" || lexical == "<" || lexical == ">") &&
-                currentPos.src[currentPos.idx] == '=')
-            {
-                lexical.push_back(currentPos.src[currentPos.idx]);
-                currentPos.advance();
-            }
-            result.value.push_back(
-                Token(SYMBOLS.at(lexical), lexical, previousPos, currentPos));
-        }
-        else
-        {
-            string details = "unexpected character '" +
-                             string(1, currentPos.src[currentPos.idx]) +
-                             "' found.";
-            currentPos.advance();
-            result.errors.push_back(Error(ErrorType::ILLEGAL_CHARACTER_ERROR,
-                                          details, previousPos, currentPos));
+            cerr << "Error: the program does not use the variable '" << name
+                 << "'." << endl;
+            return 1;
         }
     }
-};
-
-// ==================================================
-// AST
-// ==================================================
-
-enum class AstType
-{
-    AST_PROGRAM,
-    AST_STATEMENT,
-    AST_ASSIGN,
-    AST_LABEL,
-    AST_GOTO,
-    AST_IF,
-    AST_PRINT,
-    AST_EXPRESSION,
-    AST_PRIMARY,
-    AST_VARIABLE,
-    AST_LITERAL
-};
-
-struct AstStatement;
 
-struct AstLiteral
-{
-    Token tokenLiteral;
-};
-
-struct AstVariable
-{
-    Token tokenVariable;
-};
-
-struct AstPrimary
-{
-    AstType type;
-    union
+    auto results = runBatch(program, columnsResult.value, simd);
+    int status = 0;
+    for (int row = 0; row < results.size(); row++)
     {
-        AstLiteral *astLiteral;
-        AstVariable *astVariable;
-    };
-
-    ~AstPrimary()
-    {
-        switch (type)
+        cout << "===== row " << row << " =====" << endl;
+        cout << results[row].output;
+        cout.flush();
+        if (results[row].status == RunStatus::ERROR)
         {
-        case AstType::AST_LITERAL:
-            delete astLiteral;
-            break;
-        case AstType::AST_VARIABLE:
-            delete astVariable;
-            break;
-        default:
-            cerr << "Error: This is very much unexpected. PANICING!!!" << endl;
-            exit(1);
+            cerr << results[row].error << endl;
+            status = 1;
         }
     }
-};
+    return status;
+}
 
-struct AstExpression
+// runs the program once per record of `recordsFile`, standard input for "-",
+// with the output of every record on stdout and its errors on stderr
+static int runRecords(const Program &program, const string &recordsFile,
+                      const StreamOptions &options, bool showStats)
 {
-    AstPrimary *left;
-    Token tokenOperator;
-    AstPrimary *right;
-
-    ~AstExpression()
+    int fd = 0;
+    if (recordsFile != "-" && (fd = open(recordsFile.c_str(), O_RDONLY)) < 0)
     {
-        delete left;
-        delete right;
+        cerr << "Error: no such file '" << recordsFile << "' exists." << endl;
+        return 1;
     }
-};
-
-struct AstPrint
-{
-    Token tokenPrint;
-    AstExpression *astExpression;
-    Token tokenSemiColon;
-
-    ~AstPrint()
+    cout.flush();
+    auto streamResult = runStream(
+        program, fd, recordsFile != "-" ? recordsFile : "<stdin>", 1, 2,
+        options);
+    if (fd != 0)
+        close(fd);
+    if (streamResult.errors.size())
     {
-        delete astExpression;
+        for (auto error : streamResult.errors)
+        {
+            cerr << error << endl;
+        }
+        return 1;
     }
-};
+    auto &stats = streamResult.value;
+    if (showStats)
+    {
+        auto seconds = max(stats.seconds, 1e-9);
+        cerr << "===== stream =====" << endl
+             << "records:  " << stats.records << " (" << stats.failed
+             << " failed)" << endl
+             << "input:    " << stats.bytesIn << " bytes" << endl
+             << "output:   " << stats.bytesOut << " bytes" << endl
+             << "time:     " << stats.seconds << " s" << endl
+             << "records/s " << (long long)(stats.records / seconds) << endl
+             << "MB/s in   " << stats.bytesIn / seconds / 1e6 << endl
+             << "===== end of stream =====" << endl;
+    }
+    return stats.failed ? 1 : 0;
+}
 
-struct AstIf
+// runs the program on stdin a statement at a time, as it arrives
+static int runPipeline(long long fuel)
 {
-    Token tokenIf;
-    Token tokenLParen;
-    AstExpression *astExpression;
-    Token tokenRParen;
-    AstStatement *astStatement;
-
-    ~AstIf()
+    PipelineOptions options;
+    options.fuel = fuel;
+    auto result = runPipeline(0, "<stdin>", cout, options);
+    cout.flush();
+    if (result.errors.size())
     {
-        delete astExpression;
-        delete astStatement;
+        for (auto error : result.errors)
+        {
+            cerr << error << endl;
+        }
+        return 1;
     }
-};
-
-struct AstGoto
-{
-    Token tokenGoto;
-    AstVariable *astVariable;
-    Token tokenSemiColon;
-
-    ~AstGoto()
+    if (result.status == RunStatus::SUSPENDED)
     {
-        delete astVariable;
+        cerr << "Error: ran out of fuel after " << fuel << " backward jumps."
+             << endl;
+        return 2;
     }
-};
+    return 0;
+}
 
-struct AstLabel
-{
-    Token tokenLabel;
-    AstVariable *astVariable;
-    Token tokenSemiColon;
+static void usage(ostream &err)
+{
+    err << "usage: sweet [options] <file>" << endl
+        << "       sweet [-O0] [--fuel <n>] [--mem-stats] -" << endl
+        << "       sweet --serve [--socket <path>] [--workers <n>]" << endl
+        << "options:" << endl
+        << "  --tokens    print the tokens before running" << endl
+        << "  --ast       print the ast before running" << endl
+        << "  --bytecode  print the compiled program before running" << endl
+        << "  -O0         do not optimize the program" << endl
+        << "  --remarks   report what the optimizer removed" << endl
+        << "  --ranges    print the values every variable can take" << endl
+        << "  --values    report the operations and copies the optimizer "
+           "removed"
+        << endl
+        << "  --fuel <n>  stop after <n> backward jumps" << endl
+        << "  --tiered    start without optimizing, optimize once a loop "
+           "gets hot"
+        << endl
+        << "  --tier-up <n>" << endl
+        << "              with --tiered, a loop is hot after <n> backward "
+           "jumps"
+        << endl
+        << "  --tier-stats" << endl
+        << "              with --tiered, report when the run tiered up"
+        << endl
+        << "  --profile[=text|folded|json]" << endl
+        << "              report where the run spent its time" << endl
+        << "  --profile-out <file>" << endl
+        << "              write the profile to <file> instead of stderr"
+        << endl
+        << "  --profile-generate <file>" << endl
+        << "              write what the run did to <file> for --profile-use"
+        << endl
+        << "  --profile-use <file>" << endl
+        << "              optimize for the runs recorded in <file>" << endl
+        << "  --mem-stats report allocations by phase and type" << endl
+        << "  --batch <file>" << endl
+        << "              run once for every row of the columns in <file>"
+        << endl
+        << "  --no-simd   run the rows of a batch one at a time" << endl
+        << "  --records <file|->" << endl
+        << "              run once for every record of <file> or stdin"
+        << endl
+        << "  --workers <n>" << endl
+        << "              run the records or serve on <n> threads" << endl
+        << "  --stream-stats" << endl
+        << "              report the records per second afterwards" << endl
+        << "  --no-cache  neither replay nor store the output of the run"
+        << endl
+        << "  --verify-cache" << endl
+        << "              run even when cached, failing if the output differs"
+        << endl
+        << "  --cache-dir <dir>" << endl
+        << "              keep cached runs in <dir>" << endl
+        << "  --cache-size <mb>" << endl
+        << "              keep at most <mb> megabytes of cached runs" << endl
+        << "  --serve     answer sweetc on a Unix socket, keeping compiled"
+        << endl
+        << "              programs warm" << endl
+        << "  --socket <path>" << endl
+        << "              the socket to serve on" << endl
+        << "  --request-fuel <n>" << endl
+        << "              with --serve, stop every request after <n> "
+           "backward jumps"
+        << endl;
+}
 
-    ~AstLabel()
-    {
-        delete astVariable;
-    }
+struct Options
+{
+    bool showTokens = false, showAst = false, showBytecode = false;
+    bool optimize = true, showRemarks = false, showRanges = false;
+    bool showValues = false;
+    bool tiered = false, showTierStats = false;
+    TierOptions tierOptions;
+    bool simd = true, showStreamStats = false;
+    StreamOptions streamOptions;
+    long long fuel = -1;
+    string filename, profileFormat, profileOut, batchFile, recordsFile;
+    string profileGenerate, profileUse;
+    string profileText; // what the --profile-use file holds
+    bool useCache = true, verifyCache = false;
+    string cacheDir = defaultCacheDirectory();
+    long long cacheMegabytes = 64;
+    bool memStats = false, serve = false;
+    string socketPath = defaultSocketPath();
+    long long requestFuel = 1000000000; // -1 for no limit
+    // asked between slices of a run, which stops once it returns true
+    function<bool()> cancelled;
 };
 
-struct AstAssign
-{
-    AstVariable *astVariable;
-    Token tokenEqual;
-    AstExpression *astExpression;
-    Token tokenSemiColon;
-
-    ~AstAssign()
-    {
-        delete astVariable;
-        delete astExpression;
-    }
-};
+// fills `options` from the command line, false after reporting to `err`
+// when it does not make sense
+static bool parseArguments(const vector<string> &args, Options &options,
+                           ostream &err)
+{
+    for (int i = 0; i < args.size(); i++)
+    {
+        auto &arg = args[i];
+        bool hasValue = optionTakesValue(arg) && i + 1 < args.size();
+        if (arg == "--tokens")
+            options.showTokens = true;
+        else if (arg == "--ast")
+            options.showAst = true;
+        else if (arg == "--bytecode")
+            options.showBytecode = true;
+        else if (arg == "-O0")
+            options.optimize = false;
+        else if (arg == "--remarks")
+            options.showRemarks = true;
+        else if (arg == "--ranges")
+            options.showRanges = true;
+        else if (arg == "--values")
+            options.showValues = true;
+        else if (arg == "--tiered")
+            options.tiered = true;
+        else if (arg == "--tier-up" && hasValue)
+            options.tierOptions.threshold = atoll(args[++i].c_str());
+        else if (arg == "--tier-stats")
+            options.showTierStats = true;
+        else if (arg == "--fuel" && hasValue)
+            options.fuel = atoll(args[++i].c_str());
+        else if (arg == "--profile")
+            options.profileFormat = "text";
+        else if (arg.rfind("--profile=", 0) == 0)
+            options.profileFormat = arg.substr(10);
+        else if (arg == "--profile-out" && hasValue)
+            options.profileOut = args[++i];
+        else if (arg == "--profile-generate" && hasValue)
+            options.profileGenerate = args[++i];
+        else if (arg == "--profile-use" && hasValue)
+            options.profileUse = args[++i];
+        else if (arg == "--mem-stats")
+            options.memStats = true;
+        else if (arg == "--batch" && hasValue)
+            options.batchFile = args[++i];
+        else if (arg == "--no-simd")
+            options.simd = false;
+        else if (arg == "--records" && hasValue)
+            options.recordsFile = args[++i];
+        else if (arg == "--workers" && hasValue)
+            options.streamOptions.workers = atoi(args[++i].c_str());
+        else if (arg == "--stream-stats")
+            options.showStreamStats = true;
+        else if (arg == "--no-cache")
+            options.useCache = false;
+        else if (arg == "--verify-cache")
+            options.verifyCache = true;
+        else if (arg == "--cache-dir" && hasValue)
+            options.cacheDir = args[++i];
+        else if (arg == "--cache-size" && hasValue)
+            options.cacheMegabytes = atoll(args[++i].c_str());
+        else if (arg == "--serve")
+            options.serve = true;
+        else if (arg == "--socket" && hasValue)
+            options.socketPath = args[++i];
+        else if (arg == "--request-fuel" && hasValue)
+            options.requestFuel = atoll(args[++i].c_str());
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            err << "Error: unknown option '" << arg << "'." << endl;
+            usage(err);
+            return false;
+        }
+        else
+            options.filename = arg;
+    }
+    auto &profileFormat = options.profileFormat;
+    if (profileFormat != "" && profileFormat != "text" &&
+        profileFormat != "folded" && profileFormat != "json")
+    {
+        err << "Error: unknown profile format '" << profileFormat << "'."
+            << endl;
+        return false;
+    }
+    bool profiled = profileFormat != "" || options.profileGenerate != "";
+    if (profiled && options.fuel >= 0)
+    {
+        err << "Error: --profile and --profile-generate can not be combined "
+               "with --fuel."
+            << endl;
+        return false;
+    }
+    if (profiled && (options.showRemarks || options.showRanges ||
+                     options.showValues || options.profileUse != ""))
+    {
+        err << "Error: --profile and --profile-generate run the program "
+               "unoptimized, which can not be combined with --remarks, "
+               "--ranges, --values or --profile-use."
+            << endl;
+        return false;
+    }
+    // the optimizer folds whole loops into one instruction and drops stores
+    // nothing reads, which would leave the hottest statements out of the
+    // counts
+    if (profiled)
+        options.optimize = false;
+    if (options.batchFile != "" && (profiled || options.fuel >= 0))
+    {
+        err << "Error: --batch can not be combined with --profile, "
+               "--profile-generate or --fuel."
+            << endl;
+        return false;
+    }
+    if (options.recordsFile != "" &&
+        (profiled || options.fuel >= 0 || options.batchFile != ""))
+    {
+        err << "Error: --records can not be combined with --profile, "
+               "--profile-generate, --fuel or --batch."
+            << endl;
+        return false;
+    }
+    if (options.tiered &&
+        (!options.optimize || options.showRemarks || options.showRanges ||
+         options.showValues || profiled || options.profileUse != "" ||
+         options.fuel >= 0 || options.batchFile != "" ||
+         options.recordsFile != "" || options.filename == "-"))
+    {
+        err << "Error: --tiered optimizes while running, which can not be "
+               "combined with -O0, --remarks, --ranges, --values, --profile, "
+               "--profile-generate, --profile-use, --fuel, --batch, "
+               "--records or a program read from stdin."
+            << endl;
+        return false;
+    }
+    if (options.showTierStats && !options.tiered)
+    {
+        err << "Error: --tier-stats needs --tiered." << endl;
+        return false;
+    }
+    if (options.filename == "-" &&
+        (options.showTokens || options.showAst || options.showBytecode ||
+         options.showRemarks || options.showRanges || options.showValues ||
+         profiled ||
+         options.profileUse != "" || options.batchFile != "" ||
+         options.recordsFile != ""))
+    {
+        err << "Error: a program read from stdin is run as it arrives, which "
+               "can not be combined with --tokens, --ast, --bytecode, "
+               "--remarks, --ranges, --values, --profile, "
+               "--profile-generate, --profile-use, --batch or --records."
+            << endl;
+        return false;
+    }
+    if (options.filename.empty() && !options.serve)
+    {
+        err << "Error: expected an input file." << endl;
+        usage(err);
+        return false;
+    }
+    return true;
+}
 
-struct AstStatement
+// lexes, parses and compiles `source`, printing what the options ask for;
+// null once the errors are printed when it does not compile
+static shared_ptr<const Program> compileSource(const Options &options,
+                                               const string &source,
+                                               ostream &out, ostream &err)
 {
-    AstType type;
-    union
-    {
-        AstPrint *astPrint;
-        AstIf *astIf;
-        AstGoto *astGoto;
-        AstLabel *astLabel;
-        AstAssign *astAssign;
-    };
-
-    ~AstStatement()
+    Lexer lexer(options.filename, source);
+    auto lexerResult = lexer.tokenize();
+    if (lexerResult.errors.size())
     {
-        switch (type)
+        for (auto error : lexerResult.errors)
         {
-        case AstType::AST_PRINT:
-            delete astPrint;
-            break;
-        case AstType::AST_IF:
-            delete astIf;
-            break;
-        case AstType::AST_GOTO:
-            delete astGoto;
-            break;
-        case AstType::AST_LABEL:
-            delete astLabel;
-            break;
-        case AstType::AST_ASSIGN:
-            delete astAssign;
-            break;
-        default:
-            cerr << "Error: This is very much unexpected. PANICING!!!" << endl;
-            exit(1);
+            err << error << endl;
         }
+        return nullptr;
     }
-};
-
-struct AstProgram
-{
-    vector<AstStatement *> statements;
-
-    ~AstProgram()
+    if (options.showTokens)
     {
-        for (auto statement : statements)
+        MemoryScope scope(MemoryPhase::PHASE_PRINTER);
+        out << "===== all the tokens =====" << endl;
+        for (auto token : lexerResult.value)
         {
-            delete statement;
+            out << token << endl;
         }
+        out << "===== end of all the tokens =====" << endl;
+        out << endl;
     }
-};
-
-// ==================================================
-// Parser
-// ==================================================
 
-struct ParserResult
-{
-    shared_ptr<AstProgram> value = nullptr;
-    vector<Error> errors;
-};
-
-struct Parser
-{
-    Parser(vector<Token> program) : cur{0}, tokens{program} {}
-
-    ParserResult parse()
+    Parser parser(move(lexerResult.value));
+    auto parserResult = parser.parse();
+    if (parserResult.errors.size())
     {
-        AstProgram *program = new AstProgram;
-        while (cur < tokens.size())
+        for (auto error : parserResult.errors)
         {
-            auto statement = parseStatement();
-            if (statement == nullptr)
-            {
-                delete program;
-                program = nullptr;
-                break;
-            }
-            program->statements.push_back(statement);
+            err << error << endl;
         }
-        results.value = shared_ptr<AstProgram>(program);
-        return results;
+        return nullptr;
+    }
+    if (options.showAst)
+    {
+        out << "===== start of ast =====" << endl;
+        printAstProgram(out, parserResult.value.get());
+        out << "===== end of ast tree =====" << endl;
+        out << endl;
     }
 
-private:
-    int cur;
-    vector<Token> tokens;
-    ParserResult results;
-
-    AstStatement *parseStatement()
+    Compiler compiler(parserResult.value.get());
+    auto compilerResult = compiler.compile();
+    if (compilerResult.errors.size())
     {
-        if (tokens[cur].typ == TokenType::TT_VARIABLE)
+        for (auto error : compilerResult.errors)
         {
-            auto res = parseAssign();
-            if (res == nullptr)
-                return nullptr;
-            auto ast = new AstStatement;
-            ast->type = AstType::AST_ASSIGN;
-            ast->astAssign = res;
-            return ast;
+            err << error << endl;
         }
-        if (tokens[cur].typ == TokenType::TT_LABEL)
+        return nullptr;
+    }
+    // a tiered run optimizes once it knows where
+    if (options.optimize && !options.tiered)
+    {
+        SourceProfileResult profileResult;
+        if (options.profileUse != "")
         {
-            auto res = parseLabel();
-            if (res == nullptr)
+            profileResult =
+                readSourceProfile(options.profileUse, options.profileText);
+            if (profileResult.errors.size())
+            {
+                for (auto error : profileResult.errors)
+                {
+                    err << error << endl;
+                }
                 return nullptr;
-            auto ast = new AstStatement;
-            ast->type = AstType::AST_LABEL;
-            ast->astLabel = res;
-            return ast;
+            }
         }
-        if (tokens[cur].typ == TokenType::TT_GOTO)
+        Optimizer optimizer(*compilerResult.value,
+                            options.profileUse != "" ? &profileResult.value
+                                                     : nullptr);
+        auto optimizerResult = optimizer.optimize();
+        compilerResult.value = optimizerResult.value;
+        if (options.showRemarks)
         {
-            auto res = parseGoto();
-            if (res == nullptr)
-                return nullptr;
-            auto ast = new AstStatement;
-            ast->type = AstType::AST_GOTO;
-            ast->astGoto = res;
-            return ast;
+            for (auto remark : optimizerResult.remarks)
+            {
+                err << remark << endl;
+            }
         }
-        if (tokens[cur].typ == TokenType::TT_IF)
+        if (options.showRanges)
         {
-            auto res = parseIf();
-            if (res == nullptr)
-                return nullptr;
-            auto ast = new AstStatement;
-            ast->type = AstType::AST_IF;
-            ast->astIf = res;
-            return ast;
+            printRanges(out, optimizerResult.ranges);
+            out << endl;
         }
-        if (tokens[cur].typ == TokenType::TT_PRINT)
+        if (options.showValues)
         {
-            auto res = parsePrint();
-            if (res == nullptr)
-                return nullptr;
-            auto ast = new AstStatement;
-            ast->type = AstType::AST_PRINT;
-            ast->astPrint = res;
-            return ast;
+            printValues(out, optimizerResult.values);
+            out << endl;
         }
-        // something went wrong, unexprected token
-        return (AstStatement *)unexpectedError(tokens[cur]);
-        return nullptr;
-    }
-
-    AstIf *parseIf()
-    {
-        auto ifToken = tokens[cur++];
-
-        if (cur >= tokens.size())
-            return (AstIf *)eofError(tokens.back(), "(");
-        if (tokens[cur].typ != TokenType::TT_LPAREN)
-            return (AstIf *)unexpectedError(tokens[cur], "(");
-        auto lParenToken = tokens[cur++];
-
-        auto astExpression = parseExpression();
-        if (astExpression == nullptr)
-            return nullptr;
-
-        if (cur >= tokens.size())
-            return (AstIf *)eofError(tokens.back(), ")");
-        if (tokens[cur].typ != TokenType::TT_RPAREN)
-            return (AstIf *)unexpectedError(tokens[cur], ")");
-        auto rParenToken = tokens[cur++];
-
-        auto astStatement = parseStatement();
-        if (astStatement == nullptr)
-            return nullptr;
-
-        auto res = new AstIf;
-        res->tokenIf = ifToken;
-        res->tokenLParen = lParenToken;
-        res->astExpression = astExpression;
-        res->tokenRParen = rParenToken;
-        res->astStatement = astStatement;
-        return res;
-    }
-
-    AstPrint *parsePrint()
-    {
-        auto printToken = tokens[cur++];
-        auto astExpression = parseExpression();
-        if (astExpression == nullptr)
-            return nullptr;
-
-        if (cur >= tokens.size())
-            return (AstPrint *)eofError(tokens.back(), ";");
-        if (tokens[cur].typ != TokenType::TT_SEMI_COLON)
-            return (AstPrint *)unexpectedError(tokens[cur], ";");
-        auto semiColonToken = tokens[cur++];
-
-        auto res = new AstPrint;
-        res->tokenPrint = printToken;
-        res->astExpression = astExpression;
-        res->tokenSemiColon = semiColonToken;
-        return res;
     }
+    return compilerResult.value;
+}
 
-    AstLabel *parseLabel()
-    {
-        auto labelToken = tokens[cur++];
-        auto astVariable = parseVariable();
-        if (astVariable == nullptr)
-            return nullptr;
-        if (cur >= tokens.size())
-            return (AstLabel *)eofError(tokens.back(), ";");
-        if (tokens[cur].typ != TokenType::TT_SEMI_COLON)
-            return (AstLabel *)unexpectedError(tokens[cur], ";");
-        auto semiColonToken = tokens[cur++];
-        auto res = new AstLabel;
-        res->tokenLabel = labelToken;
-        res->astVariable = astVariable;
-        res->tokenSemiColon = semiColonToken;
-        return res;
-    }
+// backward jumps a run that can be cancelled takes between asking
+static const int64_t CANCEL_SLICE = 1 << 20;
 
-    AstGoto *parseGoto()
+// runs `step` with slices of the fuel the options give until the run is done,
+// the fuel is gone or `options.cancelled` says to stop
+template <typename Step>
+static RunResult runSliced(const Options &options, Step step)
+{
+    int64_t fuel = options.fuel;
+    for (;;)
     {
-        auto gotoToken = tokens[cur++];
-        auto astVariable = parseVariable();
-        if (astVariable == nullptr)
-            return nullptr;
-        if (cur >= tokens.size())
-            return (AstGoto *)eofError(tokens.back(), ";");
-        if (tokens[cur].typ != TokenType::TT_SEMI_COLON)
-            return (AstGoto *)unexpectedError(tokens[cur], ";");
-        auto semiColonToken = tokens[cur++];
-        auto res = new AstGoto;
-        res->tokenGoto = gotoToken;
-        res->astVariable = astVariable;
-        res->tokenSemiColon = semiColonToken;
-        return res;
+        auto budget = fuel >= 0 ? min(CANCEL_SLICE, fuel) : CANCEL_SLICE;
+        auto result = step(budget);
+        if (fuel >= 0)
+            fuel -= budget - result.fuel;
+        if (result.status != RunStatus::SUSPENDED || fuel == 0 ||
+            options.cancelled())
+            return result;
     }
+}
 
-    AstVariable *parseVariable()
+// runs a compiled program the way the options ask, returning the exit status
+static int runProgram(const Options &options, const Program &program,
+                      ostream &out, ostream &err)
+{
+    if (options.showBytecode)
     {
-        if (cur >= tokens.size())
-            return (AstVariable *)eofError(tokens.back(), "variable");
-        if (tokens[cur].typ != TokenType::TT_VARIABLE)
-            return (AstVariable *)unexpectedError(tokens[cur], "variable");
-        auto res = new AstVariable;
-        res->tokenVariable = tokens[cur++];
-        return res;
+        out << "===== start of bytecode =====" << endl;
+        printProgram(out, program);
+        out << "===== end of bytecode =====" << endl;
+        out << endl;
     }
 
-    AstAssign *parseAssign()
-    {
-        auto astVariable = parseVariable();
-        if (astVariable == nullptr)
-            return nullptr;
-
-        if (cur >= tokens.size())
-            return (AstAssign *)eofError(tokens.back(), "=");
-        if (tokens[cur].typ != TokenType::TT_EQUAL)
-            return (AstAssign *)unexpectedError(tokens[cur], "=");
-        auto equalToken = tokens[cur++];
-
-        auto astExpression = parseExpression();
-        if (astExpression == nullptr)
-            return nullptr;
+    if (options.batchFile != "")
+        return runBatch(program, options.batchFile, options.simd);
+    if (options.recordsFile != "")
+        return runRecords(program, options.recordsFile, options.streamOptions,
+                          options.showStreamStats);
 
-        if (cur >= tokens.size())
-            return (AstAssign *)eofError(tokens.back(), ";");
-        if (tokens[cur].typ != TokenType::TT_SEMI_COLON)
-            return (AstAssign *)unexpectedError(tokens[cur], ";");
-        auto semiColonToken = tokens[cur++];
-
-        auto res = new AstAssign;
-        res->astVariable = astVariable;
-        res->tokenEqual = equalToken;
-        res->astExpression = astExpression;
-        res->tokenSemiColon = semiColonToken;
-        return res;
-    }
-
-    AstExpression *parseExpression()
+    Context context(program, out);
+    RunResult runResult;
+    if (options.profileFormat != "" || options.profileGenerate != "")
     {
-        auto left = parsePrimary();
-        if (left == nullptr)
-            return nullptr;
-
-        // check if the operator exists
-        if (cur >= tokens.size())
-            return (AstExpression *)eofError(tokens.back(), ";");
-        bool isOperator = false;
-        for (auto op : OPERATORS)
-        {
-            if (op.second == tokens[cur].typ)
-            {
-                isOperator = true;
-                break;
-            }
-        }
-        if (!isOperator)
-        {
-            auto res = new AstExpression;
-            res->left = left;
-            res->right = nullptr;
-            return res;
-        }
-        auto op = tokens[cur++];
-
-        auto right = parsePrimary();
-        if (left == nullptr)
-            return nullptr;
-
-        auto res = new AstExpression;
-        res->left = left;
-        res->right = right;
-        res->tokenOperator = op;
-        return res;
-    }
+        Profile profile(program);
+        if (options.cancelled)
+            runResult = runSliced(options, [&](int64_t fuel)
+                                  { return run(context, profile, fuel); });
+        else
+            runResult = run(context, profile);
+        out.flush();
 
-    AstPrimary *parsePrimary()
-    {
-        if (cur >= tokens.size())
-            return (AstPrimary *)eofError(tokens.back(), "primary");
-        if (tokens[cur].typ == TokenType::TT_VARIABLE)
+        if (options.profileFormat != "")
         {
-            auto astVariable = parseVariable();
-            if (astVariable == nullptr)
-                return nullptr;
-            auto res = new AstPrimary;
-            res->type = AstType::AST_VARIABLE;
-            res->astVariable = astVariable;
-            return res;
+            ofstream file;
+            if (options.profileOut != "")
+                file.open(options.profileOut);
+            ostream &report = options.profileOut != "" ? file : err;
+            if (options.profileFormat == "folded")
+                printProfileFolded(report, program, profile);
+            else if (options.profileFormat == "json")
+                printProfileJson(report, program, profile);
+            else
+                printProfile(report, program, profile);
         }
-        if (tokens[cur].typ == TokenType::TT_LITERAL)
+        if (options.profileGenerate != "")
         {
-            auto astLiteral = parseLiteral();
-            if (astLiteral == nullptr)
-                return nullptr;
-            auto res = new AstPrimary;
-            res->type = AstType::AST_VARIABLE;
-            res->astLiteral = astLiteral;
-            return res;
+            ofstream file(options.profileGenerate);
+            writeSourceProfile(file, sourceProfile(program, profile));
+            if (!file.flush())
+            {
+                err << "Error: could not write the profile to '"
+                    << options.profileGenerate << "'." << endl;
+                return 1;
+            }
         }
-        // something went wrong, unexprected token
-        return (AstPrimary *)unexpectedError(tokens[cur]);
-    }
-
-    AstLiteral *parseLiteral()
-    {
-        if (cur >= tokens.size())
-            return (AstLiteral *)eofError(tokens.back(), "literal");
-        if (tokens[cur].typ != TokenType::TT_LITERAL)
-            return (AstLiteral *)unexpectedError(tokens[cur], "literal");
-        auto res = new AstLiteral;
-        res->tokenLiteral = tokens[cur++];
-        return res;
     }
-
-    // helper functions
-
-    void *eofError(Token token, string expected)
-    {
-        string details = "expected '" + expected + "', instead reached eof.";
-        auto error = Error(ErrorType::EOF_ERROR, details,
-                           token.startPos, token.endPos);
-        results.errors.push_back(error);
-        return nullptr;
+    else if (options.tiered)
+    {
+        TierStats stats;
+        auto tierOptions = options.tierOptions;
+        tierOptions.fuel = options.fuel;
+        tierOptions.cancelled = options.cancelled;
+        runResult = runTiered(program, out, tierOptions, stats);
+        out.flush();
+        if (options.showTierStats)
+            printTierStats(err, stats);
+    }
+    else if (options.cancelled)
+        runResult = runSliced(options, [&](int64_t fuel)
+                              { return run(context, fuel); });
+    else if (options.fuel >= 0)
+        runResult = run(context, options.fuel);
+    else
+        runResult = run(context);
+    out.flush();
+    if (runResult.status == RunStatus::ERROR)
+    {
+        err << runResult.error << endl;
+        return 1;
     }
-
-    void *unexpectedError(Token token, string expected = "")
+    if (runResult.status == RunStatus::SUSPENDED)
     {
-        string details = "unexpected token '" + token.lex + "' found";
-        if (expected != "")
-            details += ", was expecting '" + expected + "'.";
-        auto error = Error(ErrorType::UNEXPECTED_TOKEN_ERROR, details,
-                           token.startPos, token.endPos);
-        results.errors.push_back(error);
-        return nullptr;
+        err << "Error: ran out of fuel after " << options.fuel
+            << " backward jumps." << endl;
+        return 2;
     }
-};
-
-// ==================================================
-// Print AST
-// ==================================================
 
-void printAstVariable(AstVariable *variable, string prefix)
-{
-    cout << "AstVariable" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << variable->tokenVariable << endl;
+    return 0;
 }
 
-void printAstLiteral(AstLiteral *literal, string prefix)
+static int runSource(const Options &options, const string &source,
+                     ostream &out, ostream &err)
 {
-    cout << "AstLiteral" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << literal->tokenLiteral << endl;
+    auto program = compileSource(options, source, out, err);
+    if (!program)
+        return 1;
+    return runProgram(options, *program, out, err);
 }
 
-void printAstPrimary(AstPrimary *primary, string prefix)
+// passes everything written to a stream on and keeps a copy of the first
+// `limit` bytes
+struct TeeBuffer : streambuf
 {
-    cout << "AstPrimary" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    switch (primary->type)
+    TeeBuffer(streambuf *to, size_t limit) : to{to}, limit{limit} {}
+
+    int overflow(int c) override
     {
-    case AstType::AST_VARIABLE:
-        printAstVariable(primary->astVariable, prefix + "  ");
-        break;
-    case AstType::AST_LITERAL:
-        printAstLiteral(primary->astLiteral, prefix + "  ");
-        break;
-    default:
-        cerr << "Error: This is very much unexpected. PANICING!!!" << endl;
-        exit(1);
+        if (c == EOF)
+            return to->pubsync() == 0 ? 0 : EOF;
+        char ch = c;
+        keep(&ch, 1);
+        return to->sputc(ch);
     }
-}
 
-void printAstExpression(AstExpression *expression, string prefix)
-{
-    cout << "AstExpression" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    auto tempPrefix = expression->right ? prefix + "| " : prefix + "  ";
-    printAstPrimary(expression->left, tempPrefix);
-    if (expression->right)
+    streamsize xsputn(const char *data, streamsize count) override
     {
-        cout << prefix << "| " << endl;
-        cout << prefix << "+-" << expression->tokenOperator << endl;
-        cout << prefix << "| " << endl;
-        cout << prefix << "+-";
-        printAstPrimary(expression->right, prefix + "  ");
+        keep(data, count);
+        return to->sputn(data, count);
     }
-}
 
-void printAstGoto(AstGoto *astGoto, string prefix)
-{
-    cout << "AstGoto" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << astGoto->tokenGoto << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstVariable(astGoto->astVariable, prefix + "| ");
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << astGoto->tokenSemiColon << endl;
-}
+    int sync() override { return to->pubsync(); }
 
-void printAstLabel(AstLabel *label, string prefix)
-{
-    cout << "AstLabel" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << label->tokenLabel << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstVariable(label->astVariable, prefix + "| ");
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << label->tokenSemiColon << endl;
-}
+    void keep(const char *data, size_t count)
+    {
+        if (kept.size() + count > limit)
+            overflowed = true;
+        else if (!overflowed)
+            kept.append(data, count);
+    }
 
-void printAstPrint(AstPrint *print, string prefix)
-{
-    cout << "AstPrint" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << print->tokenPrint << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstExpression(print->astExpression, prefix + "| ");
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << print->tokenSemiColon << endl;
-}
+    streambuf *to;
+    size_t limit;
+    string kept;
+    bool overflowed = false;
+};
 
-void printAstAssign(AstAssign *assign, string prefix)
-{
-    cout << "AstAssign" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstVariable(assign->astVariable, prefix + "| ");
-    cout << prefix << "|" << endl;
-    cout << prefix << "+-" << assign->tokenEqual << endl;
-    cout << prefix << "|" << endl;
-    cout << prefix << "+-";
-    printAstExpression(assign->astExpression, prefix + "| ");
-    cout << prefix << "|" << endl;
-    cout << prefix << "+-" << assign->tokenSemiColon << endl;
+// runs `source` unless the cache has its output, which is then replayed as
+// it was printed; with --verify-cache it always runs and compares
+static int runCached(const Options &options, const string &source)
+{
+    OutputCache cache(options.cacheDir,
+                      (uint64_t)options.cacheMegabytes * 1024 * 1024);
+    auto key = cacheKey(
+        {options.filename, source,
+         string(options.showTokens ? "t" : "") +
+             (options.showAst ? "a" : "") +
+             (options.showBytecode ? "b" : "") +
+             (options.optimize ? "" : "0") +
+             (options.showRemarks ? "r" : "") +
+             (options.showRanges ? "g" : "") +
+             (options.showValues ? "v" : "") + (options.tiered ? "T" : "") +
+             to_string(options.fuel),
+         options.profileText});
+
+    CachedRun cached;
+    bool hit = cache.lookup(key, cached);
+    if (hit && !options.verifyCache)
+    {
+        cout << cached.out;
+        cout.flush();
+        cerr << cached.err;
+        return cached.status;
+    }
+
+    TeeBuffer outBuffer(cout.rdbuf(), cache.maxBytes());
+    TeeBuffer errBuffer(cerr.rdbuf(), cache.maxBytes());
+    ostream out(&outBuffer), err(&errBuffer);
+    err.setf(ios::unitbuf);
+    int status = runSource(options, source, out, err);
+    out.flush();
+
+    CachedRun fresh{move(outBuffer.kept), move(errBuffer.kept), status};
+    if (outBuffer.overflowed || errBuffer.overflowed)
+        return status;
+    cache.store(key, fresh);
+    if (hit && (cached.out != fresh.out || cached.err != fresh.err ||
+                cached.status != fresh.status))
+    {
+        cerr << "Error: the cached run of '" << options.filename
+             << "' differs from a fresh one." << endl;
+        return 3;
+    }
+    return status;
 }
 
-void printAstStatement(AstStatement *statement, string prefix);
-
-void printAstIf(AstIf *astIf, string prefix)
+// compiled programs the daemon keeps, the ones used longest ago dropped
+// first once there are more than `capacity`
+struct ProgramCache
 {
-    cout << "AstIf" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << astIf->tokenIf << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << astIf->tokenLParen << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstExpression(astIf->astExpression, prefix + "| ");
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-" << astIf->tokenRParen << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    printAstStatement(astIf->astStatement, prefix + "  ");
-}
+    ProgramCache(size_t capacity) : capacity{capacity} {}
 
-void printAstStatement(AstStatement *statement, string prefix)
-{
-    cout << "AstStatement" << endl;
-    cout << prefix << "| " << endl;
-    cout << prefix << "+-";
-    switch (statement->type)
+    shared_ptr<const Program> find(const string &key)
     {
-    case AstType::AST_PRINT:
-        printAstPrint(statement->astPrint, prefix + "  ");
-        break;
-    case AstType::AST_IF:
-        printAstIf(statement->astIf, prefix + "  ");
-        break;
-    case AstType::AST_GOTO:
-        printAstGoto(statement->astGoto, prefix + "  ");
-        break;
-    case AstType::AST_ASSIGN:
-        printAstAssign(statement->astAssign, prefix + "  ");
-        break;
-    case AstType::AST_LABEL:
-        printAstLabel(statement->astLabel, prefix + "  ");
-        break;
-    default:
-        cerr << "Error: This is very much unexpected. PANICING!!!" << endl;
-        exit(1);
+        lock_guard<mutex> guard(lock);
+        auto it = programs.find(key);
+        if (it == programs.end())
+            return nullptr;
+        used.splice(used.begin(), used, it->second.second);
+        return it->second.first;
     }
-}
 
-void printAstProgram(AstProgram *program, string prefix = "")
-{
-    cout << "AstProgram" << endl;
-    for (int i = 0; i < program->statements.size(); i++)
+    void add(const string &key, shared_ptr<const Program> program)
     {
-        cout << prefix << "| " << endl;
-        cout << prefix << "+-";
-        auto tempPrefix = (i == program->statements.size() - 1 ? prefix + "  "
-                                                               : prefix + "| ");
-        printAstStatement(program->statements[i], tempPrefix);
+        lock_guard<mutex> guard(lock);
+        if (programs.count(key))
+            return;
+        used.push_front(key);
+        programs[key] = {program, used.begin()};
+        if (programs.size() > capacity)
+        {
+            programs.erase(used.back());
+            used.pop_back();
+        }
     }
+
+private:
+    size_t capacity;
+    mutex lock;
+    list<string> used;
+    unordered_map<string, pair<shared_ptr<const Program>, list<string>::iterator>>
+        programs;
+};
+
+// keeps answering sweetc, compiling every distinct program only once
+static int serveForever(const Options &options)
+{
+    ProgramCache programs(256);
+    auto handler = [&](const vector<string> &args, const string &source,
+                       ostream &out, ostream &err)
+    {
+        Options request, defaults;
+        if (!parseArguments(args, request, err))
+            return 1;
+        // the daemon never uses the output cache, so the options that set
+        // it up would be silently ignored
+        if (request.serve || request.memStats || request.batchFile != "" ||
+            request.recordsFile != "" || request.profileOut != "" ||
+            request.profileGenerate != "" || request.profileUse != "" ||
+            request.verifyCache || request.cacheDir != defaults.cacheDir ||
+            request.cacheMegabytes != defaults.cacheMegabytes)
+        {
+            err << "Error: --serve, --mem-stats, --batch, --records, "
+                   "--profile-out, --profile-generate, --profile-use, "
+                   "--verify-cache, --cache-dir and --cache-size can not be "
+                   "sent to the daemon."
+                << endl;
+            return 1;
+        }
+        // every request pays for its backward jumps out of the daemon's
+        // budget, and stops once its client no longer takes what it prints
+        if (options.requestFuel >= 0 &&
+            (request.fuel < 0 || request.fuel > options.requestFuel))
+            request.fuel = options.requestFuel;
+        request.cancelled = [&out, &err]() { return !out || !err; };
+
+        // the tokens, the ast, the remarks, the ranges and the values only
+        // come out of compiling
+        if (request.showTokens || request.showAst || request.showRemarks ||
+            request.showRanges || request.showValues)
+            return runSource(request, source, out, err);
+        auto key = cacheKey(
+            {request.filename, source,
+             request.tiered ? "T" : request.optimize ? "O" : "O0"});
+        auto program = programs.find(key);
+        if (!program)
+        {
+            program = compileSource(request, source, out, err);
+            if (!program)
+                return 1;
+            programs.add(key, program);
+        }
+        return runProgram(request, *program, out, err);
+    };
+
+    cerr << "serving on " << options.socketPath << endl;
+    auto problem =
+        serve(options.socketPath, options.streamOptions.workers, handler);
+    cerr << "Error: " << problem << endl;
+    return 1;
 }
 
 int main(int argc, const char **argv)
 {
-    if (argc <= 1)
-    {
-        cerr << "Error: expected an input file." << endl;
-        return 1;
-    }
-    string filename(argv[1]);
-
-    ifstream fs(filename);
-    if (!fs.good())
-    {
-        cerr << "Error: no such file '" << filename << "' exists." << endl;
+    MemoryReport memoryReport;
+    Options options;
+    if (!parseArguments(vector<string>(argv + 1, argv + argc), options, cerr))
         return 1;
-    }
+    if (options.serve)
+        return serveForever(options);
 
-    string source, line;
-    while (getline(fs, line))
-    {
-        source += line + "\n";
-    }
-    fs.close();
+    memoryReport.enabled = options.memStats;
+    setMemoryTracking(memoryReport.enabled);
 
-    cout << "===== content of " << filename << " =====" << endl;
-    cout << source << endl;
-    cout << "===== end of content =====" << endl;
-    cout << endl;
+    if (options.filename == "-")
+        return runPipeline(options.fuel);
 
-    Lexer lexer(filename, source);
-    auto lexerResult = lexer.tokenize();
-    if (lexerResult.errors.size())
-    {
-        for (auto error : lexerResult.errors)
-        {
-            cerr << error << endl;
-        }
+    string source;
+    if (!readFile(options.filename, source))
         return 1;
-    }
-    cout << "===== all the tokens =====" << endl;
-    for (auto token : lexerResult.value)
-    {
-        cout << token << endl;
-    }
-    cout << "===== end of all the tokens =====" << endl;
-    cout << endl;
-
-    Parser parser(lexerResult.value);
-    auto parserResult = parser.parse();
-    if (parserResult.errors.size())
-    {
-        for (auto error : parserResult.errors)
-        {
-            cerr << error << endl;
-        }
+    if (options.profileUse != "" &&
+        !readFile(options.profileUse, options.profileText))
         return 1;
-    }
-
-    cout << "===== start of ast =====" << endl;
-    printAstProgram(parserResult.value.get());
-    cout << "===== end of ast tree =====" << endl;
 
-    return 0;
-}
\ No newline at end of file
+    // only runs that read nothing but their source and the profile they are
+    // optimized for, and report nothing about how they ran, are the same
+    // every time
+    if (options.useCache && options.profileFormat == "" &&
+        options.profileGenerate == "" && !options.showTierStats &&
+        options.batchFile == "" && options.recordsFile == "" &&
+        !options.memStats)
+        return runCached(options, source);
+    return runSource(options, source, cout, cerr);
+}
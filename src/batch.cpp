@@ -0,0 +1,580 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
+
+#include "sweet/batch.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/token.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Columns
+// ==================================================
+
+ColumnsResult readColumns(const std::string &filename,
+                          const std::string &source)
+{
+    ColumnsResult result;
+    std::unordered_set<std::string> seen;
+    Position pos(filename);
+    auto current = [&]() -> char
+    { return pos.idx < source.size() ? source[pos.idx] : 0; };
+    auto error = [&](const std::string &details, const Position &start)
+    {
+        result.errors.push_back(
+            Error(ErrorType::INPUT_ERROR, details, start, pos));
+        // carry on with the next line
+        while (current() && current() != '\n')
+            pos.advance(current());
+    };
+
+    while (pos.idx < source.size())
+    {
+        auto start = pos;
+        char c = current();
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        {
+            pos.advance(c);
+            continue;
+        }
+        if (c == '#')
+        {
+            while (current() && current() != '\n')
+                pos.advance(current());
+            continue;
+        }
+        if (!isalpha(c) && c != '_')
+        {
+            error("expected the name of a variable.", start);
+            continue;
+        }
+
+        std::string name;
+        while (isalnum(current()) || current() == '_')
+        {
+            name.push_back(current());
+            pos.advance(current());
+        }
+        if (keywordType(name) != TokenType::TT_VARIABLE)
+        {
+            error("'" + name + "' is a keyword, not a variable.", start);
+            continue;
+        }
+        if (!seen.insert(name).second)
+        {
+            error("variable '" + name + "' already has a column.", start);
+            continue;
+        }
+
+        std::vector<Value> values;
+        bool failed = false;
+        while (!failed && current() && current() != '\n' && current() != '#')
+        {
+            c = current();
+            if (c == ' ' || c == '\t' || c == '\r')
+            {
+                pos.advance(c);
+                continue;
+            }
+            auto valueStart = pos;
+            auto first = source.data() + pos.idx;
+            auto last = first;
+            while (*last && !isspace(*last) && *last != '#')
+                last++;
+            Value value;
+            auto parsed = std::from_chars(first, last, value);
+            for (auto p = first; p < last; p++)
+                pos.advance(*p);
+            if (parsed.ec == std::errc::result_out_of_range)
+            {
+                error("value '" + std::string(first, last) +
+                          "' does not fit in a 64 bit integer.",
+                      valueStart);
+                failed = true;
+            }
+            else if (parsed.ec != std::errc() || parsed.ptr != last)
+            {
+                error("expected a number, found '" +
+                          std::string(first, last) + "'.",
+                      valueStart);
+                failed = true;
+            }
+            else
+                values.push_back(value);
+        }
+        if (failed)
+            continue;
+        if (!result.value.values.empty() &&
+            values.size() != result.value.rows())
+        {
+            error("variable '" + name + "' has " +
+                      std::to_string(values.size()) + " values instead of " +
+                      std::to_string(result.value.rows()) + ".",
+                  start);
+            continue;
+        }
+        result.value.names.push_back(name);
+        result.value.values.push_back(values);
+    }
+    return result;
+}
+
+// ==================================================
+// Batch
+// ==================================================
+
+// lanes are only passed between the functions of this file, so the calling
+// convention for them does not matter
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef Value Lanes __attribute__((vector_size(BATCH_LANES * sizeof(Value))));
+typedef std::uint64_t UnsignedLanes
+    __attribute__((vector_size(BATCH_LANES * sizeof(Value))));
+
+// pc of the lanes that stopped, or never started
+static const Value DONE = INT64_MAX;
+
+static Lanes broadcast(Value value)
+{
+    // filling in the lanes one by one would go through memory
+    return Lanes{} + value;
+}
+
+// `a` in the lanes of `mask`, `b` in the others
+static Lanes blend(const Lanes &mask, const Lanes &a, const Lanes &b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+// lanes are kept in plain arrays of values, which need not be as aligned as
+// a whole vector of them
+static Lanes load(const Value *values)
+{
+    Lanes lanes;
+    std::memcpy(&lanes, values, sizeof(lanes));
+    return lanes;
+}
+
+static void store(Value *values, const Lanes &lanes)
+{
+    std::memcpy(values, &lanes, sizeof(lanes));
+}
+
+// the horizontal operations fold the upper half of the lanes onto the lower
+// one until the first lane holds the result
+static_assert(BATCH_LANES == 4, "the folds below are written for 4 lanes");
+
+static bool any(const Lanes &mask)
+{
+    Lanes folded = mask | __builtin_shufflevector(mask, mask, 2, 3, 0, 1);
+    folded |= __builtin_shufflevector(folded, folded, 1, 0, 1, 0);
+    return folded[0] != 0;
+}
+
+static Value minimum(const Lanes &lanes)
+{
+    Lanes other = __builtin_shufflevector(lanes, lanes, 2, 3, 0, 1);
+    Lanes folded = blend((Lanes)(other < lanes), other, lanes);
+    other = __builtin_shufflevector(folded, folded, 1, 0, 1, 0);
+    folded = blend((Lanes)(other < folded), other, folded);
+    return folded[0];
+}
+
+struct Batch
+{
+    const Program &program;
+    std::vector<Value> slots; // BATCH_LANES values per slot
+    Value pcs[BATCH_LANES];   // where every lane starts, DONE if it does not
+    LaneResult *results;
+    std::vector<Value> scratch; // one lane's slots, for runLoop
+};
+
+// records the error the lanes of `failed` stopped with at `pc`
+static void fail(Batch &batch, const Lanes &failed, int pc, ErrorType type,
+                 const char *details)
+{
+    auto &statement = batch.program.statements[batch.program.code[pc].stmt];
+    for (int lane = 0; lane < BATCH_LANES; lane++)
+    {
+        if (!failed[lane])
+            continue;
+        batch.results[lane].status = RunStatus::ERROR;
+        batch.results[lane].error =
+            Error(type, details, statement.startPos, statement.endPos);
+    }
+}
+
+// lanes run the same instruction for as long as they are at the same pc;
+// once a branch splits them the lanes furthest behind go first, so that the
+// others wait for them where their paths meet again. Each lane still runs its
+// instructions in the order run() would
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+#endif
+static void execute(Batch &batch)
+{
+    auto code = batch.program.code.data();
+    auto slots = batch.slots.data();
+    auto get = [&](int slot) { return load(slots + slot * BATCH_LANES); };
+    auto put = [&](int slot, const Lanes &lanes)
+    { store(slots + slot * BATCH_LANES, lanes); };
+
+    // while every lane still running is at `pc`, `converged` is set and the
+    // pcs of the lanes are not kept up to date
+    Lanes pcs = load(batch.pcs);
+    Lanes live = (Lanes)(pcs != DONE);
+    Value pc = minimum(pcs);
+    Lanes mask = (Lanes)(pcs == pc);
+    bool converged = !any(mask ^ live);
+
+    auto diverge = [&]()
+    {
+        if (converged)
+            pcs = blend(live, broadcast(pc), broadcast(DONE));
+        converged = false;
+    };
+    auto reschedule = [&]()
+    {
+        pc = minimum(pcs);
+        mask = (Lanes)(pcs == pc);
+        converged = !any(mask ^ live);
+    };
+    auto stop = [&](const Lanes &lanes)
+    {
+        diverge();
+        pcs = blend(lanes, broadcast(DONE), pcs);
+        live &= ~lanes;
+        mask &= ~lanes;
+    };
+
+    while (pc != DONE)
+    {
+        auto &ins = code[pc];
+        bool jump = false;
+        Lanes taken;
+        switch (ins.op)
+        {
+        case OpCode::OP_MOVE:
+            put(ins.dst, blend(mask, get(ins.a), get(ins.dst)));
+            break;
+        case OpCode::OP_ADD:
+        {
+            Lanes a = get(ins.a), b = get(ins.b);
+            Lanes value = (Lanes)((UnsignedLanes)a + (UnsignedLanes)b);
+            Lanes overflow = (Lanes)(((a ^ value) & (b ^ value)) < 0) & mask;
+            if (any(overflow))
+            {
+                fail(batch, overflow, pc, ErrorType::OVERFLOW_ERROR,
+                     "result of '+' does not fit in 64 bits.");
+                stop(overflow);
+            }
+            put(ins.dst, blend(mask, value, get(ins.dst)));
+            break;
+        }
+        case OpCode::OP_SUB:
+        {
+            Lanes a = get(ins.a), b = get(ins.b);
+            Lanes value = (Lanes)((UnsignedLanes)a - (UnsignedLanes)b);
+            Lanes overflow = (Lanes)(((a ^ b) & (a ^ value)) < 0) & mask;
+            if (any(overflow))
+            {
+                fail(batch, overflow, pc, ErrorType::OVERFLOW_ERROR,
+                     "result of '-' does not fit in 64 bits.");
+                stop(overflow);
+            }
+            put(ins.dst, blend(mask, value, get(ins.dst)));
+            break;
+        }
+        case OpCode::OP_MUL:
+        {
+            // there is no SIMD multiplication that reports overflow
+            Lanes a = get(ins.a), b = get(ins.b);
+            Lanes value = get(ins.dst), overflow = {};
+            for (int lane = 0; lane < BATCH_LANES; lane++)
+            {
+                Value product;
+                if (!mask[lane])
+                    continue;
+                if (__builtin_mul_overflow(a[lane], b[lane], &product))
+                    overflow[lane] = -1;
+                else
+                    value[lane] = product;
+            }
+            if (any(overflow))
+            {
+                fail(batch, overflow, pc, ErrorType::OVERFLOW_ERROR,
+                     "result of '*' does not fit in 64 bits.");
+                stop(overflow);
+            }
+            put(ins.dst, value);
+            break;
+        }
+        case OpCode::OP_DIV:
+        {
+            Lanes a = get(ins.a), b = get(ins.b);
+            Lanes value = get(ins.dst), byZero = {}, overflow = {};
+            for (int lane = 0; lane < BATCH_LANES; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                if (b[lane] == 0)
+                    byZero[lane] = -1;
+                else if (b[lane] == -1 && a[lane] == INT64_MIN)
+                    overflow[lane] = -1;
+                else
+                    value[lane] = a[lane] / b[lane];
+            }
+            if (any(byZero))
+            {
+                fail(batch, byZero, pc, ErrorType::DIVISION_BY_ZERO_ERROR,
+                     "division by zero.");
+                stop(byZero);
+            }
+            if (any(overflow))
+            {
+                fail(batch, overflow, pc, ErrorType::OVERFLOW_ERROR,
+                     "result of '/' does not fit in 64 bits.");
+                stop(overflow);
+            }
+            put(ins.dst, value);
+            break;
+        }
+        case OpCode::OP_ADD_UNCHECKED:
+            put(ins.dst, blend(mask,
+                               (Lanes)((UnsignedLanes)get(ins.a) +
+                                       (UnsignedLanes)get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_SUB_UNCHECKED:
+            put(ins.dst, blend(mask,
+                               (Lanes)((UnsignedLanes)get(ins.a) -
+                                       (UnsignedLanes)get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_MUL_UNCHECKED:
+            put(ins.dst, blend(mask,
+                               (Lanes)((UnsignedLanes)get(ins.a) *
+                                       (UnsignedLanes)get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_DIV_UNCHECKED:
+        {
+            // only the lanes that are at it are known not to divide by zero
+            Lanes a = get(ins.a), b = get(ins.b), value = get(ins.dst);
+            for (int lane = 0; lane < BATCH_LANES; lane++)
+                if (mask[lane])
+                    value[lane] = a[lane] / b[lane];
+            put(ins.dst, value);
+            break;
+        }
+        // SIMD comparisons give -1 where they hold, sweet wants 1
+        case OpCode::OP_EQ:
+            put(ins.dst, blend(mask, -(Lanes)(get(ins.a) == get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_LT:
+            put(ins.dst, blend(mask, -(Lanes)(get(ins.a) < get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_LE:
+            put(ins.dst, blend(mask, -(Lanes)(get(ins.a) <= get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_GT:
+            put(ins.dst, blend(mask, -(Lanes)(get(ins.a) > get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_GE:
+            put(ins.dst, blend(mask, -(Lanes)(get(ins.a) >= get(ins.b)),
+                               get(ins.dst)));
+            break;
+        case OpCode::OP_PRINT:
+        {
+            Lanes value = get(ins.a);
+            for (int lane = 0; lane < BATCH_LANES; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                char digits[24];
+                auto end = std::to_chars(digits, digits + 23, value[lane]).ptr;
+                *end++ = '\n';
+                batch.results[lane].output.append(digits, end);
+            }
+            break;
+        }
+        case OpCode::OP_JUMP:
+            jump = true;
+            taken = mask;
+            break;
+        case OpCode::OP_JUMP_EQ:
+            jump = true;
+            taken = (Lanes)(get(ins.a) == get(ins.b));
+            break;
+        case OpCode::OP_JUMP_NE:
+            jump = true;
+            taken = (Lanes)(get(ins.a) != get(ins.b));
+            break;
+        case OpCode::OP_JUMP_LT:
+            jump = true;
+            taken = (Lanes)(get(ins.a) < get(ins.b));
+            break;
+        case OpCode::OP_JUMP_LE:
+            jump = true;
+            taken = (Lanes)(get(ins.a) <= get(ins.b));
+            break;
+        case OpCode::OP_JUMP_GT:
+            jump = true;
+            taken = (Lanes)(get(ins.a) > get(ins.b));
+            break;
+        case OpCode::OP_JUMP_GE:
+            jump = true;
+            taken = (Lanes)(get(ins.a) >= get(ins.b));
+            break;
+        case OpCode::OP_LOOP:
+        {
+            // loops are worked out one lane at a time on a copy of its slots
+            auto &loop = batch.program.loops[ins.a];
+            auto &scratch = batch.scratch;
+            jump = true;
+            taken = Lanes{};
+            for (int lane = 0; lane < BATCH_LANES; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                for (int slot = 0; slot < scratch.size(); slot++)
+                    scratch[slot] = slots[slot * BATCH_LANES + lane];
+                if (runLoop(batch.program, loop, scratch.data(), INT64_MAX) <
+                    0)
+                    continue;
+                for (int slot = 0; slot < scratch.size(); slot++)
+                    slots[slot * BATCH_LANES + lane] = scratch[slot];
+                taken[lane] = -1;
+            }
+            break;
+        }
+        case OpCode::OP_HALT:
+            stop(mask);
+            reschedule();
+            continue;
+        }
+
+        if (!jump)
+        {
+            if (converged)
+            {
+                pc++;
+                continue;
+            }
+            // the lanes that were waiting at the next instruction join in
+            pcs = blend(mask, broadcast(pc + 1), pcs);
+            pc++;
+            mask = (Lanes)(pcs == pc);
+            if (any(mask))
+                converged = !any(mask ^ live);
+            else
+                reschedule();
+            continue;
+        }
+
+        taken &= mask;
+        if (converged)
+        {
+            if (!any(taken))
+            {
+                pc++;
+                continue;
+            }
+            if (!any(taken ^ mask))
+            {
+                pc = ins.target;
+                continue;
+            }
+            diverge();
+        }
+        pcs = blend(mask,
+                    blend(taken, broadcast(ins.target), broadcast(pc + 1)),
+                    pcs);
+        reschedule();
+    }
+}
+
+// without AVX2 there is no comparison of 64 bit lanes and the lanes end up
+// slower than the scalar engine
+static bool lanesPay()
+{
+#if defined(__x86_64__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;
+#endif
+}
+
+std::vector<LaneResult> runBatch(const Program &program,
+                                 const Columns &columns, bool simd)
+{
+    MemoryScope scope(MemoryPhase::PHASE_RUNTIME);
+    int rows = columns.rows();
+    std::vector<LaneResult> results(rows);
+    std::vector<int> slotOf;
+    for (auto &name : columns.names)
+        slotOf.push_back(program.slotOf(name));
+
+    if (!simd || !lanesPay())
+    {
+        Context context(program);
+        for (int row = 0; row < rows; row++)
+        {
+            std::ostringstream out;
+            context.reset();
+            context.out = &out;
+            for (int column = 0; column < slotOf.size(); column++)
+                if (slotOf[column] >= 0)
+                    context.slots[slotOf[column]] = columns.values[column][row];
+            auto result = run(context);
+            results[row].status = result.status;
+            results[row].error = result.error;
+            results[row].output = out.str();
+        }
+        return results;
+    }
+
+    Batch batch{program,
+                std::vector<Value>(program.slotCount() * BATCH_LANES),
+                {},
+                nullptr,
+                std::vector<Value>(program.slotCount())};
+    for (int first = 0; first < rows; first += BATCH_LANES)
+    {
+        int count = std::min(BATCH_LANES, rows - first);
+        auto slots = batch.slots.data();
+        for (int slot = 0; slot < program.slotCount(); slot++)
+        {
+            auto value = program.isConstant(slot)
+                             ? program.constantValue(slot)
+                             : 0;
+            std::fill(slots + slot * BATCH_LANES,
+                      slots + (slot + 1) * BATCH_LANES, value);
+        }
+        for (int column = 0; column < slotOf.size(); column++)
+        {
+            if (slotOf[column] < 0)
+                continue;
+            for (int lane = 0; lane < count; lane++)
+                slots[slotOf[column] * BATCH_LANES + lane] =
+                    columns.values[column][first + lane];
+        }
+        for (int lane = 0; lane < BATCH_LANES; lane++)
+            batch.pcs[lane] = lane < count ? 0 : DONE;
+        batch.results = results.data() + first;
+        execute(batch);
+    }
+    return results;
+}
+
+} // namespace sweet
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "sweet/cache.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Output cache
+// ==================================================
+
+namespace fs = std::filesystem;
+
+// the Makefile passes the hash of every source and header the library is
+// built from; a build that does not falls back to when this file was compiled
+#ifndef SWEET_ENGINE_HASH
+#define SWEET_ENGINE_HASH __DATE__ " " __TIME__
+#endif
+
+const std::string &engineVersion()
+{
+    static const std::string version = std::string("sweet ") + SWEET_ENGINE_HASH;
+    return version;
+}
+
+static std::uint32_t rotate(std::uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+std::string sha256(const std::string &text)
+{
+    static const std::uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    std::uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                          0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    // the message padded with a one bit, zeros and its length in bits
+    std::string message = text;
+    message += (char)0x80;
+    while (message.size() % 64 != 56)
+        message += (char)0;
+    std::uint64_t bits = (std::uint64_t)text.size() * 8;
+    for (int i = 7; i >= 0; i--)
+        message += (char)(bits >> (i * 8));
+
+    for (std::size_t chunk = 0; chunk < message.size(); chunk += 64)
+    {
+        std::uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+        {
+            auto byte = (const unsigned char *)&message[chunk + i * 4];
+            w[i] = (std::uint32_t)byte[0] << 24 | byte[1] << 16 |
+                   byte[2] << 8 | byte[3];
+        }
+        for (int i = 16; i < 64; i++)
+        {
+            auto s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^
+                      (w[i - 15] >> 3);
+            auto s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^
+                      (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4],
+                      f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; i++)
+        {
+            auto s1 = rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25);
+            auto choice = (e & f) ^ (~e & g);
+            auto t1 = hh + s1 + choice + k[i] + w[i];
+            auto s0 = rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22);
+            auto majority = (a & b) ^ (a & c) ^ (b & c);
+            auto t2 = s0 + majority;
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (auto word : h)
+        for (int i = 28; i >= 0; i -= 4)
+            hex += digits[(word >> i) & 15];
+    return hex;
+}
+
+std::string cacheKey(const std::vector<std::string> &parts)
+{
+    // every part after its length, so that no two lists hash the same text
+    std::string text = engineVersion();
+    for (auto &part : parts)
+        text += "\n" + std::to_string(part.size()) + ":" + part;
+    return sha256(text);
+}
+
+std::string defaultCacheDirectory()
+{
+    if (auto directory = std::getenv("SWEET_CACHE_DIR"))
+        return directory;
+    if (auto cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return std::string(cache) + "/sweet";
+    if (auto home = std::getenv("HOME"); home && *home)
+        return std::string(home) + "/.cache/sweet";
+    return "";
+}
+
+// an entry is a header line and the two outputs back to back:
+//
+//     sweet-cache 1 <status> <stdout bytes> <stderr bytes>
+static const char *const MAGIC = "sweet-cache 1";
+
+OutputCache::OutputCache(const std::string &directory, std::uint64_t maxBytes)
+    : directory{directory}, limit{maxBytes}
+{
+}
+
+std::string OutputCache::path(const std::string &key) const
+{
+    return directory + "/" + key + ".run";
+}
+
+bool OutputCache::lookup(const std::string &key, CachedRun &run)
+{
+    if (directory.empty())
+        return false;
+    std::ifstream file(path(key), std::ios::binary);
+    if (!file)
+        return false;
+
+    std::string header;
+    std::size_t outSize, errSize;
+    if (!std::getline(file, header))
+        return false;
+    std::istringstream fields(header);
+    std::string magic, version;
+    fields >> magic >> version >> run.status >> outSize >> errSize;
+    if (!fields || magic + " " + version != MAGIC)
+        return false;
+
+    // a truncated or damaged header must not size the outputs past what the
+    // file could hold
+    std::error_code error;
+    auto fileSize = fs::file_size(path(key), error);
+    if (error || outSize > fileSize || errSize > fileSize - outSize ||
+        outSize + errSize > limit)
+        return false;
+    run.out.resize(outSize);
+    run.err.resize(errSize);
+    if (!file.read(&run.out[0], outSize) || !file.read(&run.err[0], errSize))
+        return false;
+
+    fs::last_write_time(path(key), fs::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool OutputCache::store(const std::string &key, const CachedRun &run)
+{
+    if (directory.empty() || run.out.size() + run.err.size() > limit)
+        return false;
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    // written aside and renamed into place, so that a run reading the entry
+    // at the same time sees all of it or nothing
+    auto temporary = path(key) + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << MAGIC << " " << run.status << " " << run.out.size() << " "
+             << run.err.size() << "\n"
+             << run.out << run.err;
+        if (!file.flush())
+        {
+            fs::remove(temporary, error);
+            return false;
+        }
+    }
+    fs::rename(temporary, path(key), error);
+    if (error)
+    {
+        fs::remove(temporary, error);
+        return false;
+    }
+    evict();
+    return true;
+}
+
+void OutputCache::evict()
+{
+    struct Entry
+    {
+        fs::file_time_type used;
+        std::uint64_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+    std::error_code error;
+    for (fs::directory_iterator it(directory, error), end; !error && it != end;
+         it.increment(error))
+    {
+        if (it->path().extension() != ".run")
+            continue;
+        std::error_code failed;
+        auto size = it->file_size(failed);
+        auto used = it->last_write_time(failed);
+        if (failed)
+            continue;
+        entries.push_back(Entry{used, size, it->path()});
+        total += size;
+    }
+    if (total <= limit)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    for (auto &entry : entries)
+    {
+        if (total <= limit)
+            break;
+        if (fs::remove(entry.path, error))
+            total -= entry.size;
+    }
+}
+
+} // namespace sweet
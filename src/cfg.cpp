@@ -0,0 +1,127 @@
+#include "sweet/cfg.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Control flow graph
+// ==================================================
+
+Cfg::Cfg(const Program &program) : blockOf(program.code.size())
+{
+    auto &code = program.code;
+    std::vector<bool> leader(code.size() + 1);
+    leader[0] = true;
+    for (int i = 0; i < code.size(); i++)
+    {
+        if (isJump(code[i].op))
+            leader[code[i].target] = true;
+        if (isJump(code[i].op) || code[i].op == OpCode::OP_HALT)
+            leader[i + 1] = true;
+    }
+
+    for (int i = 0; i < code.size(); i++)
+    {
+        if (leader[i])
+            blocks.push_back(BasicBlock{i, i, {}, {}});
+        blocks.back().end = i + 1;
+        blockOf[i] = blocks.size() - 1;
+    }
+
+    for (int b = 0; b < blocks.size(); b++)
+    {
+        auto &last = code[blocks[b].end - 1];
+        if (last.op != OpCode::OP_HALT && last.op != OpCode::OP_JUMP &&
+            blocks[b].end < code.size())
+            blocks[b].succs.push_back(b + 1);
+        if (isJump(last.op))
+        {
+            int target = blockOf[last.target];
+            if (blocks[b].succs.empty() || blocks[b].succs[0] != target)
+                blocks[b].succs.push_back(target);
+        }
+        for (auto succ : blocks[b].succs)
+            blocks[succ].preds.push_back(b);
+    }
+}
+
+std::vector<bool> Cfg::reachable() const
+{
+    std::vector<bool> seen(blocks.size());
+    if (blocks.empty())
+        return seen;
+    std::vector<int> stack{0};
+    seen[0] = true;
+    while (!stack.empty())
+    {
+        int b = stack.back();
+        stack.pop_back();
+        for (auto succ : blocks[b].succs)
+        {
+            if (!seen[succ])
+            {
+                seen[succ] = true;
+                stack.push_back(succ);
+            }
+        }
+    }
+    return seen;
+}
+
+// ==================================================
+// Liveness
+// ==================================================
+
+Liveness::Liveness(const Program &program, const Cfg &cfg)
+{
+    int slots = program.names.size();
+    auto &blocks = cfg.blocks;
+    std::vector<SlotSet> use(blocks.size(), SlotSet(slots)),
+        def(blocks.size(), SlotSet(slots));
+    for (int b = 0; b < blocks.size(); b++)
+    {
+        for (int i = blocks[b].start; i < blocks[b].end; i++)
+        {
+            auto &ins = program.code[i];
+            int used[2];
+            int count = usedSlots(ins, used);
+            for (int u = 0; u < count; u++)
+                if (!program.isConstant(used[u]) && !def[b].test(used[u]))
+                    use[b].set(used[u]);
+            int defined = definedSlot(ins);
+            if (defined >= 0)
+                def[b].set(defined);
+        }
+    }
+
+    liveIn.assign(blocks.size(), SlotSet(slots));
+    liveOut.assign(blocks.size(), SlotSet(slots));
+    std::vector<int> worklist;
+    std::vector<bool> queued(blocks.size(), true);
+    for (int b = 0; b < blocks.size(); b++)
+        worklist.push_back(b);
+    while (!worklist.empty())
+    {
+        int b = worklist.back();
+        worklist.pop_back();
+        queued[b] = false;
+
+        for (auto succ : blocks[b].succs)
+            liveOut[b].unite(liveIn[succ]);
+        SlotSet in = use[b];
+        for (int w = 0; w < in.words.size(); w++)
+            in.words[w] |= liveOut[b].words[w] & ~def[b].words[w];
+        if (!liveIn[b].unite(in))
+            continue;
+        for (auto pred : blocks[b].preds)
+        {
+            if (!queued[pred])
+            {
+                queued[pred] = true;
+                worklist.push_back(pred);
+            }
+        }
+    }
+}
+
+} // namespace sweet
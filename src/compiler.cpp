@@ -0,0 +1,473 @@
+#include <algorithm>
+
+#include "sweet/lexer.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+#include "sweet/parser.hpp"
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Compiler
+// ==================================================
+
+// constants are numbered from -1 downwards while compiling since their final
+// slots are only known once every variable has been seen
+static int constantSlot(int slot, int base)
+{
+    return slot < 0 ? base - slot - 1 : slot;
+}
+
+static const Token &lastToken(AstStatement *statement)
+{
+    while (statement->type == AstType::AST_IF)
+        statement = statement->astIf->astStatement;
+    switch (statement->type)
+    {
+    case AstType::AST_PRINT:
+        return statement->astPrint->tokenSemiColon;
+    case AstType::AST_GOTO:
+        return statement->astGoto->tokenSemiColon;
+    case AstType::AST_LABEL:
+        return statement->astLabel->tokenSemiColon;
+    default:
+        return statement->astAssign->tokenSemiColon;
+    }
+}
+
+static OpCode binaryOpCode(TokenType type)
+{
+    switch (type)
+    {
+    case TokenType::TT_PLUS:
+        return OpCode::OP_ADD;
+    case TokenType::TT_MINUS:
+        return OpCode::OP_SUB;
+    case TokenType::TT_MULTIPLY:
+        return OpCode::OP_MUL;
+    case TokenType::TT_DIVIDE:
+        return OpCode::OP_DIV;
+    case TokenType::TT_EQUAL_EQUAL:
+        return OpCode::OP_EQ;
+    case TokenType::TT_LESS:
+        return OpCode::OP_LT;
+    case TokenType::TT_LESS_EQUAL:
+        return OpCode::OP_LE;
+    case TokenType::TT_GREATER:
+        return OpCode::OP_GT;
+    default:
+        return OpCode::OP_GE;
+    }
+}
+
+// conditional jump taken when `a type b` evaluates to `jumpWhen`, or
+// OP_HALT when `type` is not a comparison
+static OpCode branchOpCode(TokenType type, bool jumpWhen)
+{
+    switch (type)
+    {
+    case TokenType::TT_EQUAL_EQUAL:
+        return jumpWhen ? OpCode::OP_JUMP_EQ : OpCode::OP_JUMP_NE;
+    case TokenType::TT_LESS:
+        return jumpWhen ? OpCode::OP_JUMP_LT : OpCode::OP_JUMP_GE;
+    case TokenType::TT_LESS_EQUAL:
+        return jumpWhen ? OpCode::OP_JUMP_LE : OpCode::OP_JUMP_GT;
+    case TokenType::TT_GREATER:
+        return jumpWhen ? OpCode::OP_JUMP_GT : OpCode::OP_JUMP_LE;
+    case TokenType::TT_GREATER_EQUAL:
+        return jumpWhen ? OpCode::OP_JUMP_GE : OpCode::OP_JUMP_LT;
+    default:
+        return OpCode::OP_HALT;
+    }
+}
+
+CompilerResult Compiler::compile()
+{
+    MemoryScope scope(MemoryPhase::PHASE_COMPILER);
+    program = std::make_shared<Program>();
+    for (auto statement : ast->statements)
+        compileStatement(statement);
+    stmt = -1;
+    emit(OpCode::OP_HALT, 0, 0, 0);
+
+    for (auto &pending : gotos)
+    {
+        auto &name = pending.second.lex;
+        if (!labels.count(name))
+        {
+            results.errors.push_back(
+                Error(ErrorType::UNDEFINED_LABEL_ERROR,
+                      "label '" + name + "' is not defined.",
+                      pending.second.startPos, pending.second.endPos));
+            continue;
+        }
+        program->code[pending.first].target = labels.at(name);
+    }
+
+    int base = program->constantBase();
+    for (auto &ins : program->code)
+    {
+        ins.a = constantSlot(ins.a, base);
+        ins.b = constantSlot(ins.b, base);
+    }
+
+    if (results.errors.empty())
+        results.value = program;
+    return results;
+}
+
+Compiler::Compiler() : ast{nullptr}
+{
+    program = std::make_shared<Program>();
+    appending = true;
+    stmt = -1;
+    emit(OpCode::OP_HALT, 0, 0, 0);
+}
+
+std::vector<Error> Compiler::append(AstStatement *statement)
+{
+    MemoryScope scope(MemoryPhase::PHASE_COMPILER);
+    program->code.pop_back();
+    compileStatement(statement);
+    for (auto &jump : gotos)
+    {
+        auto &name = jump.second.lex;
+        auto label = labels.find(name);
+        if (label != labels.end())
+        {
+            program->code[jump.first].target = label->second;
+            continue;
+        }
+        auto &wait = pending.emplace(name, Pending{jump.second}).first->second;
+        if (wait.trap < 0)
+        {
+            // a run going on past the goto jumps over its trap
+            emit(OpCode::OP_JUMP, 0, 0, 0, program->code.size() + 2);
+            wait.trap = emit(OpCode::OP_HALT, 0, 0, 0);
+        }
+        wait.jumps.push_back(jump.first);
+        program->code[jump.first].target = wait.trap;
+    }
+    gotos.clear();
+    emit(OpCode::OP_HALT, 0, 0, 0);
+
+    std::vector<Error> errors;
+    errors.swap(results.errors);
+    return errors;
+}
+
+const std::string *Compiler::waitsFor(int pc) const
+{
+    for (auto &wait : pending)
+        if (wait.second.trap == pc)
+            return &wait.first;
+    return nullptr;
+}
+
+int Compiler::labelAt(const std::string &name) const
+{
+    auto it = labels.find(name);
+    return it == labels.end() ? -1 : it->second;
+}
+
+std::vector<std::pair<int, Value>> Compiler::takeLiterals()
+{
+    std::vector<std::pair<int, Value>> taken;
+    taken.swap(literals);
+    return taken;
+}
+
+void Compiler::forget()
+{
+    program->code.clear();
+    program->statements.clear();
+    for (auto &constant : constantIndex)
+        freeSlots.push_back(constant.second);
+    constantIndex.clear();
+    for (auto &wait : pending)
+    {
+        wait.second.jumps.clear();
+        wait.second.trap = -1;
+    }
+    emit(OpCode::OP_HALT, 0, 0, 0);
+}
+
+std::vector<Error> Compiler::unresolved() const
+{
+    std::vector<const Token *> tokens;
+    for (auto &wait : pending)
+        tokens.push_back(&wait.second.token);
+    std::sort(tokens.begin(), tokens.end(),
+              [](const Token *a, const Token *b)
+              {
+                  return a->startPos.ln != b->startPos.ln
+                             ? a->startPos.ln < b->startPos.ln
+                             : a->startPos.col < b->startPos.col;
+              });
+    std::vector<Error> errors;
+    for (auto token : tokens)
+        errors.push_back(Error(ErrorType::UNDEFINED_LABEL_ERROR,
+                               "label '" + token->lex + "' is not defined.",
+                               token->startPos, token->endPos));
+    return errors;
+}
+
+// the body of an if is compiled right after its branch, so a chain of nested
+// ifs is compiled in a loop, patching the jumps over their bodies once the
+// innermost one is done, rather than by recursing once per level
+void Compiler::compileStatement(AstStatement *statement)
+{
+    auto outer = stmt;
+    // every if of a chain ends where its innermost body does
+    auto &endPos = lastToken(statement).endPos;
+    std::vector<int> skips;
+    for (;;)
+    {
+        stmt = program->statements.size();
+        {
+            MemoryScope scope("StatementInfo");
+            program->statements.push_back(
+                StatementInfo{statement->type, statement->startPos(), endPos});
+        }
+        if (statement->type != AstType::AST_IF)
+            break;
+
+        auto astIf = statement->astIf;
+        auto body = astIf->astStatement;
+        if (body->type == AstType::AST_GOTO)
+        {
+            // jump straight to the label instead of over an unconditional
+            // jump
+            compileBranch(astIf->astExpression, true, -1,
+                          &body->astGoto->astVariable->tokenVariable);
+            break;
+        }
+        compileBranch(astIf->astExpression, false, -1, nullptr);
+        skips.push_back(program->code.size() - 1);
+        program->statements[stmt].body = program->statements.size();
+        statement = body;
+    }
+
+    switch (statement->type)
+    {
+    case AstType::AST_ASSIGN:
+        compileAssign(statement->astAssign);
+        break;
+    case AstType::AST_LABEL:
+        compileLabel(statement->astLabel);
+        break;
+    case AstType::AST_GOTO:
+        compileGoto(statement->astGoto);
+        break;
+    case AstType::AST_PRINT:
+        compilePrint(statement->astPrint);
+        break;
+    default:
+        break;
+    }
+    for (auto jump : skips)
+        program->code[jump].target = program->code.size();
+    stmt = outer;
+}
+
+void Compiler::compileAssign(AstAssign *astAssign)
+{
+    auto expression = astAssign->astExpression;
+    auto left = compilePrimary(expression->left);
+    if (!expression->right)
+    {
+        auto dst = variable(astAssign->astVariable->tokenVariable.lex);
+        emit(OpCode::OP_MOVE, dst, left, 0);
+        return;
+    }
+    auto right = compilePrimary(expression->right);
+    auto dst = variable(astAssign->astVariable->tokenVariable.lex);
+    emit(binaryOpCode(expression->tokenOperator.typ), dst, left, right);
+}
+
+void Compiler::compileLabel(AstLabel *astLabel)
+{
+    auto &token = astLabel->astVariable->tokenVariable;
+    if (labels.count(token.lex))
+    {
+        results.errors.push_back(
+            Error(ErrorType::DUPLICATE_LABEL_ERROR,
+                  "label '" + token.lex + "' is already defined.",
+                  token.startPos, token.endPos));
+        return;
+    }
+    labels[token.lex] = program->code.size();
+
+    // only gotos read before their label was are waiting for it
+    auto wait = pending.find(token.lex);
+    if (wait == pending.end())
+        return;
+    for (auto jump : wait->second.jumps)
+        program->code[jump].target = labels[token.lex];
+    pending.erase(wait);
+}
+
+void Compiler::compileGoto(AstGoto *astGoto)
+{
+    gotos.push_back({emit(OpCode::OP_JUMP, 0, 0, 0),
+                     astGoto->astVariable->tokenVariable});
+}
+
+void Compiler::compilePrint(AstPrint *astPrint)
+{
+    auto expression = astPrint->astExpression;
+    auto value = compilePrimary(expression->left);
+    if (expression->right)
+    {
+        auto right = compilePrimary(expression->right);
+        auto dst = temporary();
+        emit(binaryOpCode(expression->tokenOperator.typ), dst, value, right);
+        value = dst;
+    }
+    emit(OpCode::OP_PRINT, 0, value, 0);
+}
+
+int Compiler::compilePrimary(AstPrimary *primary)
+{
+    if (primary->type == AstType::AST_VARIABLE)
+        return variable(primary->astVariable->tokenVariable.lex);
+
+    auto &token = primary->astLiteral->tokenLiteral;
+    Value value = 0;
+    for (auto c : token.lex)
+    {
+        if (__builtin_mul_overflow(value, 10, &value) ||
+            __builtin_add_overflow(value, c - '0', &value))
+        {
+            results.errors.push_back(
+                Error(ErrorType::OVERFLOW_ERROR,
+                      "literal '" + token.lex +
+                          "' does not fit in a 64 bit integer.",
+                      token.startPos, token.endPos));
+            return constant(0);
+        }
+    }
+    return constant(value);
+}
+
+void Compiler::compileBranch(AstExpression *condition, bool jumpWhen,
+                             int target, const Token *label)
+{
+    auto left = compilePrimary(condition->left);
+    int right = constant(0);
+    auto op = jumpWhen ? OpCode::OP_JUMP_NE : OpCode::OP_JUMP_EQ;
+    if (condition->right)
+    {
+        right = compilePrimary(condition->right);
+        op = branchOpCode(condition->tokenOperator.typ, jumpWhen);
+        // arithmetic conditions are true when they are non zero
+        if (op == OpCode::OP_HALT)
+        {
+            auto dst = temporary();
+            emit(binaryOpCode(condition->tokenOperator.typ), dst, left, right);
+            left = dst;
+            right = constant(0);
+            op = jumpWhen ? OpCode::OP_JUMP_NE : OpCode::OP_JUMP_EQ;
+        }
+    }
+    auto jump = emit(op, 0, left, right, target);
+    if (label)
+        gotos.push_back({jump, *label});
+}
+
+int Compiler::variable(const std::string &name)
+{
+    auto it = program->slotIndex.find(name);
+    if (it != program->slotIndex.end())
+        return it->second;
+    int slot = program->names.size();
+    program->names.push_back(name);
+    program->slotIndex[name] = slot;
+    return slot;
+}
+
+int Compiler::constant(Value value)
+{
+    auto it = constantIndex.find(value);
+    if (it != constantIndex.end())
+        return it->second;
+    int slot;
+    if (appending)
+    {
+        // a slot among the variables, see Compiler()
+        if (freeSlots.size())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            program->names[slot] = std::to_string(value);
+        }
+        else
+        {
+            slot = program->names.size();
+            program->names.push_back(std::to_string(value));
+        }
+        literals.push_back({slot, value});
+    }
+    else
+    {
+        slot = -1 - (int)program->constants.size();
+        program->constants.push_back(value);
+    }
+    constantIndex[value] = slot;
+    return slot;
+}
+
+int Compiler::temporary()
+{
+    // a statement needs at most one temporary and none outlive it
+    if (temp < 0)
+    {
+        temp = program->names.size();
+        program->names.push_back("$t");
+    }
+    return temp;
+}
+
+int Compiler::emit(OpCode op, int dst, int a, int b, int target)
+{
+    MemoryScope scope("Instruction");
+    program->code.push_back(Instruction{op, dst, a, b, target, stmt});
+    return program->code.size() - 1;
+}
+
+CompilerResult compile(const std::string &filename, const std::string &source,
+                       const CompileOptions &options)
+{
+    CompilerResult results;
+
+    Lexer lexer(filename, source);
+    auto lexerResult = lexer.tokenize();
+    if (lexerResult.errors.size())
+    {
+        results.errors = lexerResult.errors;
+        return results;
+    }
+
+    Parser parser(lexerResult.value);
+    auto parserResult = parser.parse();
+    if (parserResult.errors.size())
+    {
+        results.errors = parserResult.errors;
+        return results;
+    }
+
+    Compiler compiler(parserResult.value.get());
+    results = compiler.compile();
+    if (results.errors.size() || !options.optimize)
+        return results;
+
+    Optimizer optimizer(*results.value);
+    auto optimizerResult = optimizer.optimize();
+    results.value = optimizerResult.value;
+    results.remarks = optimizerResult.remarks;
+    return results;
+}
+
+} // namespace sweet
@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include "sweet/optimizer.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Induction variables
+// ==================================================
+
+typedef __int128 Wide;
+
+// the most iterations worked out in one go, which keeps every product below
+// in range of a Wide
+static const Wide MAX_TRIPS = (Wide)1 << 62;
+// the fewest times a profiled loop has to go round on average for reducing
+// its multiplications to be worth the check on entry
+static const std::uint64_t MIN_PROFILED_TRIPS = 8;
+
+static bool fits(Wide value)
+{
+    return value >= INT64_MIN && value <= INT64_MAX;
+}
+
+// smallest m >= 1 for which `x0 + m * step test bound` is false, -1 when
+// there is none below MAX_TRIPS
+static Wide tripCount(OpCode test, Wide x0, Wide step, Wide bound)
+{
+    switch (test)
+    {
+    case OpCode::OP_JUMP_LE:
+        return tripCount(OpCode::OP_JUMP_LT, x0, step, bound + 1);
+    case OpCode::OP_JUMP_GT:
+        return tripCount(OpCode::OP_JUMP_LT, -x0, -step, -bound);
+    case OpCode::OP_JUMP_GE:
+        return tripCount(OpCode::OP_JUMP_LT, -x0, -step, -bound + 1);
+    case OpCode::OP_JUMP_LT:
+    {
+        if (x0 + step >= bound)
+            return 1;
+        if (step <= 0)
+            return -1;
+        Wide trips = (bound - x0 + step - 1) / step;
+        return trips > MAX_TRIPS ? -1 : trips;
+    }
+    case OpCode::OP_JUMP_EQ:
+        if (x0 + step != bound)
+            return 1;
+        return step == 0 ? -1 : 2;
+    case OpCode::OP_JUMP_NE:
+    {
+        if (x0 + step == bound)
+            return 1;
+        if (step == 0 || (bound - x0) % step != 0 || (bound - x0) / step < 1)
+            return -1;
+        Wide trips = (bound - x0) / step;
+        return trips > MAX_TRIPS ? -1 : trips;
+    }
+    default:
+        return -1;
+    }
+}
+
+static Wide stepOf(const LinearVariable &linear, const Value *slots)
+{
+    Wide step = slots[linear.step];
+    return linear.negate ? -step : step;
+}
+
+// value of a sum after `m` iterations, false when working it out overflows
+static bool partialSum(Wide v0, Wide first, Wide step, bool negate, Wide m,
+                       Wide &sum)
+{
+    // first + (first + step) + ... over m terms
+    Wide triangle = m * (m - 1) / 2, stepped, terms;
+    if (__builtin_mul_overflow(step, triangle, &stepped) ||
+        __builtin_add_overflow(m * first, stepped, &terms))
+        return false;
+    sum = negate ? v0 - terms : v0 + terms;
+    return true;
+}
+
+// true when the sum stays in range over the iterations [1, trips]; it is a
+// quadratic in the number of iterations, so it is enough to look at both ends
+// and around its vertex
+static bool sumFits(Wide v0, Wide first, Wide step, bool negate, Wide trips)
+{
+    Wide candidates[4] = {1, trips, 1, 1};
+    if (step != 0)
+    {
+        // vertex at m = 1/2 - first/step
+        Wide vertex = (step - 2 * first) / (2 * step);
+        candidates[2] = vertex < 1 ? 1 : vertex > trips ? trips : vertex;
+        candidates[3] = candidates[2] + 1 > trips ? trips : candidates[2] + 1;
+    }
+    for (auto m : candidates)
+    {
+        Wide sum;
+        if (!partialSum(v0, first, step, negate, m, sum) || !fits(sum))
+            return false;
+    }
+    return true;
+}
+
+std::int64_t runLoop(const Program &program, const Loop &loop, Value *slots,
+                     std::int64_t maxTrips)
+{
+    auto &counter = loop.linear[loop.counter];
+    Wide trips = tripCount(loop.test, slots[counter.slot],
+                           stepOf(counter, slots), slots[loop.bound]);
+    if (trips < 0 || trips > maxTrips)
+        return -1;
+
+    // check everything before writing anything
+    for (auto &linear : loop.linear)
+        if (!fits(slots[linear.slot] + trips * stepOf(linear, slots)))
+            return -1;
+    for (auto &sum : loop.sums)
+    {
+        auto &term = loop.linear[sum.term];
+        Wide step = stepOf(term, slots);
+        Wide first = slots[term.slot] + (sum.after ? step : 0);
+        if (!sumFits(slots[sum.slot], first, step, sum.negate, trips))
+            return -1;
+    }
+    for (auto &product : loop.products)
+    {
+        auto &linear = loop.linear[product.linear];
+        Wide step = stepOf(linear, slots);
+        Wide first = slots[linear.slot] + (product.after ? step : 0);
+        Wide last = first + (trips - 1) * step, value;
+        if (__builtin_mul_overflow(first, (Wide)product.factor, &value) ||
+            !fits(value) ||
+            __builtin_mul_overflow(last, (Wide)product.factor, &value) ||
+            !fits(value))
+            return -1;
+    }
+
+    if (!loop.closed)
+    {
+        // the reduced copy adds factor * step before every use, so it starts
+        // one step before the first value; that may wrap around, the
+        // additions wrap back
+        for (auto &product : loop.products)
+        {
+            auto &linear = loop.linear[product.linear];
+            Wide step = stepOf(linear, slots);
+            Wide start = slots[linear.slot] + (product.after ? 0 : -step);
+            slots[product.slot] = (std::uint64_t)start * product.factor;
+        }
+        return trips;
+    }
+
+    // sums read the linear variables as they were when the loop started
+    for (auto &sum : loop.sums)
+    {
+        auto &term = loop.linear[sum.term];
+        Wide step = stepOf(term, slots);
+        Wide first = slots[term.slot] + (sum.after ? step : 0), value = 0;
+        partialSum(slots[sum.slot], first, step, sum.negate, trips, value);
+        slots[sum.slot] = value;
+    }
+    for (auto &linear : loop.linear)
+        slots[linear.slot] += trips * stepOf(linear, slots);
+    return trips;
+}
+
+static OpCode flipped(OpCode test)
+{
+    switch (test)
+    {
+    case OpCode::OP_JUMP_LT:
+        return OpCode::OP_JUMP_GT;
+    case OpCode::OP_JUMP_LE:
+        return OpCode::OP_JUMP_GE;
+    case OpCode::OP_JUMP_GT:
+        return OpCode::OP_JUMP_LT;
+    case OpCode::OP_JUMP_GE:
+        return OpCode::OP_JUMP_LE;
+    default:
+        return test;
+    }
+}
+
+bool Optimizer::optimizeLoops()
+{
+    auto &code = program->code;
+    std::vector<int> jumpsInto(code.size());
+    for (auto &ins : code)
+        if (isJump(ins.op))
+            jumpsInto[ins.target]++;
+
+    // going from the last loop to the first, rewriting one only ever moves
+    // instructions that come after the loops still to be looked at
+    bool changed = false;
+    for (int latch = code.size() - 1; latch >= 0; latch--)
+    {
+        if (isBranch(code[latch].op) && code[latch].target <= latch)
+            changed |= optimizeLoop(code[latch].target, latch, jumpsInto);
+    }
+    return changed;
+}
+
+bool Optimizer::optimizeLoop(int header, int latch,
+                             const std::vector<int> &jumpsInto)
+{
+    auto &code = program->code;
+    // only straight line code entered at the top
+    for (int i = header; i < latch; i++)
+        if (isJump(code[i].op) || code[i].op == OpCode::OP_HALT)
+            return false;
+    for (int i = header + 1; i <= latch; i++)
+        if (jumpsInto[i])
+            return false;
+
+    std::unordered_map<int, int> defined, definitions;
+    for (int i = header; i < latch; i++)
+    {
+        int slot = definedSlot(code[i]);
+        if (slot >= 0)
+        {
+            defined[slot] = i;
+            definitions[slot]++;
+        }
+    }
+    auto invariant = [&](int slot)
+    { return program->isConstant(slot) || !defined.count(slot); };
+
+    Loop loop;
+    std::unordered_map<int, int> linearIndex;
+    for (int i = header; i < latch; i++)
+    {
+        auto &ins = code[i];
+        if ((ins.op != OpCode::OP_ADD && ins.op != OpCode::OP_SUB) ||
+            definitions[ins.dst] != 1)
+            continue;
+        if (ins.a == ins.dst && invariant(ins.b))
+            loop.linear.push_back(LinearVariable{
+                ins.dst, ins.b, ins.op == OpCode::OP_SUB});
+        else if (ins.op == OpCode::OP_ADD && ins.b == ins.dst &&
+                 invariant(ins.a))
+            loop.linear.push_back(LinearVariable{ins.dst, ins.a, false});
+        else
+            continue;
+        linearIndex[ins.dst] = loop.linear.size() - 1;
+    }
+
+    auto &test = code[latch];
+    if (linearIndex.count(test.a) && invariant(test.b))
+    {
+        loop.counter = linearIndex[test.a];
+        loop.test = test.op;
+        loop.bound = test.b;
+    }
+    else if (linearIndex.count(test.b) && invariant(test.a))
+    {
+        loop.counter = linearIndex[test.b];
+        loop.test = flipped(test.op);
+        loop.bound = test.a;
+    }
+    else
+        return false;
+
+    // a loop that only steps and sums does not need to run at all
+    loop.closed = true;
+    for (int i = header; i < latch && loop.closed; i++)
+    {
+        auto &ins = code[i];
+        int slot = definedSlot(ins);
+        if (linearIndex.count(slot))
+            continue;
+        loop.closed = false;
+        if ((ins.op != OpCode::OP_ADD && ins.op != OpCode::OP_SUB) ||
+            definitions[slot] != 1)
+            break;
+        int term = -1;
+        if (ins.a == slot && linearIndex.count(ins.b))
+            term = ins.b;
+        else if (ins.op == OpCode::OP_ADD && ins.b == slot &&
+                 linearIndex.count(ins.a))
+            term = ins.a;
+        else
+            break;
+        loop.sums.push_back(SumVariable{slot, linearIndex[term],
+                                        defined[term] < i,
+                                        ins.op == OpCode::OP_SUB});
+        loop.closed = true;
+    }
+
+    if (loop.closed)
+    {
+        insertInstructions(header, {Instruction{OpCode::OP_LOOP, 0,
+                                                (int)program->loops.size(), 0,
+                                                latch + 2, code[header].stmt}},
+                           true);
+        code[latch + 1].target = header + 1;
+        program->loops.push_back(loop);
+        remark(code[header + 1].stmt,
+               "replaced the loop starting here by its final values.");
+        return true;
+    }
+
+    // otherwise multiplications by a linear variable can become additions, in
+    // a copy of the loop behind a check on entry. With a profile only where
+    // the loop goes round often enough for the check to pay off
+    const char *cold = nullptr;
+    if (profile && code[latch].stmt >= 0)
+    {
+        auto &info = program->statements[code[latch].stmt];
+        auto found = profile->find(info);
+        std::uint64_t back = profile->jumps(info);
+        std::uint64_t entered = found ? found->count - back : 0;
+        if (!found)
+            cold = "left the loop starting here as it is, the profile never "
+                   "saw it run.";
+        else if (back <
+                 MIN_PROFILED_TRIPS * std::max<std::uint64_t>(entered, 1))
+            cold = "left the loop starting here as it is, the profile saw it "
+                   "go round too few times.";
+    }
+    loop.sums.clear();
+    std::vector<Instruction> reduced(code.begin() + header,
+                                     code.begin() + latch + 1);
+    for (int i = header; i < latch; i++)
+    {
+        auto &ins = code[i];
+        int slot = definedSlot(ins);
+        if (ins.op != OpCode::OP_MUL || linearIndex.count(slot) ||
+            definitions[slot] != 1)
+            continue;
+        int linear = ins.b, factor = ins.a;
+        if (!linearIndex.count(linear))
+            std::swap(linear, factor);
+        if (!linearIndex.count(linear) || !program->isConstant(factor) ||
+            !program->isConstant(loop.linear[linearIndex[linear]].step))
+            continue;
+        // the product is only kept up to date from here on, so nothing in
+        // the loop may read it before
+        bool readBefore = false;
+        for (int j = header; j < i; j++)
+        {
+            int used[2];
+            int count = usedSlots(code[j], used);
+            for (int u = 0; u < count; u++)
+                readBefore |= used[u] == slot;
+        }
+        if (readBefore)
+            continue;
+        if (cold)
+        {
+            remark(code[header].stmt, cold);
+            return false;
+        }
+
+        auto &variable = loop.linear[linearIndex[linear]];
+        Value step = program->constantValue(variable.step);
+        Value value = program->constantValue(factor);
+        std::uint64_t increment = (std::uint64_t)step * value;
+        if (variable.negate)
+            increment = -increment;
+        loop.products.push_back(ReducedProduct{
+            slot, linearIndex[linear], value, defined[linear] < i});
+        reduced[i - header] =
+            Instruction{OpCode::OP_ADD_UNCHECKED, slot, slot,
+                        constant((Value)increment), -1, ins.stmt};
+    }
+    if (loop.products.empty())
+        return false;
+
+    for (int i = header; i < latch; i++)
+        if (code[i].op == OpCode::OP_MUL &&
+            reduced[i - header].op == OpCode::OP_ADD_UNCHECKED)
+            remark(code[i].stmt, "replaced the multiplication into '" +
+                                     program->names[code[i].dst] +
+                                     "' by an addition.");
+
+    // the guard in OP_LOOP already made sure the linear variables stay in
+    // range, so the copy does not need to check them
+    for (auto &ins : reduced)
+    {
+        if (!linearIndex.count(definedSlot(ins)))
+            continue;
+        ins.op = ins.op == OpCode::OP_ADD ? OpCode::OP_ADD_UNCHECKED
+                                          : OpCode::OP_SUB_UNCHECKED;
+    }
+
+    // header: LOOP, the loop as it was, a jump over the reduced copy, the
+    // reduced copy and then whatever followed the loop
+    insertInstructions(header, {Instruction{OpCode::OP_LOOP, 0,
+                                            (int)program->loops.size(), 0,
+                                            -1, code[header].stmt}},
+                       true);
+    code[latch + 1].target = header + 1;
+    int copy = latch + 3;
+    reduced.back().target = copy;
+    reduced.insert(reduced.begin(),
+                   Instruction{OpCode::OP_JUMP, 0, 0, 0,
+                               copy + (int)reduced.size(),
+                               code[latch + 1].stmt});
+    insertInstructions(latch + 2, reduced, false);
+    code[header].target = copy;
+    program->loops.push_back(loop);
+    return true;
+}
+
+} // namespace sweet
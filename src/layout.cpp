@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "sweet/cfg.hpp"
+#include "sweet/optimizer.hpp"
+#include "sweet/profiler.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Block layout
+// ==================================================
+
+struct Edge
+{
+    std::uint64_t saved; // jumps run less by laying `to` out after `from`
+    int from, to;        // blocks
+};
+
+// blocks laid out one after the other, kept as a list with a representative
+struct Chains
+{
+    Chains(int blocks) : parent(blocks), first(blocks), last(blocks),
+                         next(blocks, -1)
+    {
+        for (int b = 0; b < blocks; b++)
+            parent[b] = first[b] = last[b] = b;
+    }
+
+    int find(int b)
+    {
+        while (parent[b] != b)
+            b = parent[b] = parent[parent[b]];
+        return b;
+    }
+
+    // puts `to` right after `from` when `from` ends a chain and `to` starts
+    // another one
+    bool link(int from, int to)
+    {
+        int a = find(from), b = find(to);
+        if (a == b || last[a] != from || first[b] != to)
+            return false;
+        next[from] = to;
+        parent[b] = a;
+        last[a] = last[b];
+        return true;
+    }
+
+    std::vector<int> parent, first, last, next;
+};
+
+bool Optimizer::layoutBlocks()
+{
+    if (!profile)
+        return false;
+    auto &code = program->code;
+    auto &statements = program->statements;
+    Cfg cfg(*program);
+    auto &blocks = cfg.blocks;
+    int count = blocks.size();
+
+    auto counts = [&](int stmt) -> const StatementCounts *
+    { return stmt < 0 ? nullptr : profile->find(statements[stmt]); };
+
+    // a block ran as often as the first statement in it the profile knows
+    std::vector<std::uint64_t> runs(count);
+    for (int b = 0; b < count; b++)
+        for (int i = blocks[b].start; i < blocks[b].end; i++)
+            if (auto found = counts(code[i].stmt))
+            {
+                runs[b] = found->count;
+                break;
+            }
+
+    std::vector<int> branches(statements.size());
+    for (auto &ins : code)
+        if (isBranch(ins.op) && ins.stmt >= 0)
+            branches[ins.stmt]++;
+
+    // a branch costs the same whether it jumps or not, only the jumps a block
+    // needs when the way it goes on is not laid out right after it do. That
+    // is as often as the block ran, or for a branch that can be turned
+    // around as often as the rarer of its ways
+    std::vector<Edge> edges;
+    for (int b = 0; b < count; b++)
+    {
+        auto &last = code[blocks[b].end - 1];
+        auto &succs = blocks[b].succs;
+        bool branch = isBranch(last.op) && succs.size() > 1;
+        std::uint64_t fell = runs[b], jumped = 0;
+        if (branch)
+        {
+            auto found = counts(last.stmt);
+            fell = 0;
+            if (found && found->type == AstType::AST_IF)
+            {
+                jumped = profile->jumps(statements[last.stmt]);
+                fell = found->count - jumped;
+            }
+        }
+        for (int s = 0; s < succs.size(); s++)
+        {
+            // succs[0] is the way a block falls through if it does
+            bool falls = last.op != OpCode::OP_JUMP && s == 0;
+            std::uint64_t saved = falls ? fell : 0;
+            if (branch && (last.stmt < 0 || branches[last.stmt] == 1))
+                saved = std::min(fell, jumped);
+            else if (last.op == OpCode::OP_JUMP)
+                saved = runs[b];
+            // nothing is laid out in front of the entry
+            if (saved > 0 && succs[s] != 0)
+                edges.push_back(Edge{saved, b, succs[s]});
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(),
+                     [](const Edge &a, const Edge &b)
+                     { return a.saved > b.saved; });
+    Chains chains(count);
+    for (auto &edge : edges)
+        chains.link(edge.from, edge.to);
+
+    // the chain of the entry, then the chains that ran and last the ones
+    // that never did, each in the order they had
+    std::vector<int> order;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (int b = 0; b < count; b++)
+        {
+            if (chains.first[chains.find(b)] != b)
+                continue;
+            bool entry = b == 0, ran = runs[b] > 0;
+            if ((pass == 0 && entry) || (pass == 1 && !entry && ran) ||
+                (pass == 2 && !entry && !ran))
+                for (int at = b; at >= 0; at = chains.next[at])
+                    order.push_back(at);
+        }
+    }
+
+    // jumps are pointed at blocks until every block has its place
+    std::vector<Instruction> laid;
+    std::vector<int> startOf(count), jumps;
+    bool changed = false;
+    auto jump = [&](Instruction ins, int block)
+    {
+        ins.target = block;
+        jumps.push_back(laid.size());
+        laid.push_back(ins);
+    };
+    for (int k = 0; k < order.size(); k++)
+    {
+        int b = order[k];
+        int next = k + 1 < order.size() ? order[k + 1] : -1;
+        int fall = b + 1 < count ? b + 1 : -1;
+        startOf[b] = laid.size();
+        changed |= b != k;
+        laid.insert(laid.end(), code.begin() + blocks[b].start,
+                    code.begin() + blocks[b].end - 1);
+
+        auto last = code[blocks[b].end - 1];
+        int target = isJump(last.op) ? cfg.blockOf[last.target] : -1;
+        Instruction back{OpCode::OP_JUMP, 0, 0, 0, -1, -1};
+        if (last.op == OpCode::OP_JUMP)
+        {
+            if (target != next)
+                jump(last, target);
+            else
+                changed = true;
+        }
+        else if (isBranch(last.op) && fall != next && target == next &&
+                 (last.stmt < 0 || branches[last.stmt] == 1))
+        {
+            last.op = negatedBranch(last.op);
+            jump(last, fall);
+            changed = true;
+            if (last.stmt >= 0)
+            {
+                auto &info = statements[last.stmt];
+                info.inverted = !info.inverted;
+                remark(last.stmt, "turned the jump around, so that the block "
+                                  "the profile wants next is reached without "
+                                  "one.");
+            }
+        }
+        else if (isJump(last.op))
+        {
+            jump(last, target);
+            if (fall != next)
+                jump(back, fall);
+        }
+        else
+        {
+            laid.push_back(last);
+            if (last.op != OpCode::OP_HALT && fall >= 0 && fall != next)
+                jump(back, fall);
+        }
+    }
+    if (!changed)
+        return false;
+    for (auto at : jumps)
+        laid[at].target = startOf[laid[at].target];
+    code.swap(laid);
+    return true;
+}
+
+} // namespace sweet
@@ -0,0 +1,93 @@
+#include "sweet/cfg.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Unreachable code and dead store elimination
+// ==================================================
+
+bool Optimizer::eliminateUnreachable()
+{
+    auto &code = program->code;
+    MemoryScope scope("Cfg");
+    Cfg cfg(*program);
+    auto reachable = cfg.reachable();
+
+    std::vector<bool> removed(code.size());
+    int reported = -1;
+    for (int i = 0; i + 1 < code.size(); i++)
+    {
+        if (!reachable[cfg.blockOf[i]])
+        {
+            removed[i] = true;
+            // a statement can span several instructions, report it once
+            int stmt = code[i].stmt;
+            if (stmt != reported)
+                remark(stmt, std::string("removed unreachable ") +
+                                 statementName(
+                                     program->statements[stmt].type) +
+                                 ".");
+            reported = stmt;
+        }
+        // whichever way it goes, a jump to the next instruction ends up there
+        else if (isJump(code[i].op) && code[i].target == i + 1)
+            removed[i] = true;
+    }
+
+    for (auto flag : removed)
+    {
+        if (flag)
+        {
+            removeInstructions(removed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Optimizer::eliminateDeadStores()
+{
+    auto &code = program->code;
+    MemoryScope scope("Liveness");
+    Cfg cfg(*program);
+    Liveness liveness(*program, cfg);
+
+    std::vector<bool> removed(code.size());
+    bool changed = false;
+    for (int b = 0; b < cfg.blocks.size(); b++)
+    {
+        auto live = liveness.liveOut[b];
+        for (int i = cfg.blocks[b].end - 1; i >= cfg.blocks[b].start; i--)
+        {
+            auto &ins = code[i];
+            int defined = definedSlot(ins);
+            // a store nobody reads has to stay when it might fail, the
+            // error is part of what the program does
+            if (defined >= 0 && !live.test(defined) &&
+                !canTrap(*program, ins))
+            {
+                removed[i] = true;
+                changed = true;
+                remark(ins.stmt, "removed dead store to '" +
+                                     program->names[defined] + "'.");
+                continue;
+            }
+            if (defined >= 0)
+                live.reset(defined);
+            int used[2];
+            int count = usedSlots(ins, used);
+            for (int u = 0; u < count; u++)
+                if (!program->isConstant(used[u]))
+                    live.set(used[u]);
+        }
+    }
+
+    if (changed)
+        removeInstructions(removed);
+    return changed;
+}
+
+} // namespace sweet
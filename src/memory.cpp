@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include "sweet/memory.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Memory accounting
+// ==================================================
+
+const char *memoryPhaseName(MemoryPhase phase)
+{
+    switch (phase)
+    {
+    case MemoryPhase::PHASE_LEXER:
+        return "lexer";
+    case MemoryPhase::PHASE_PARSER:
+        return "parser";
+    case MemoryPhase::PHASE_AST:
+        return "ast";
+    case MemoryPhase::PHASE_PRINTER:
+        return "printer";
+    case MemoryPhase::PHASE_COMPILER:
+        return "compiler";
+    case MemoryPhase::PHASE_OPTIMIZER:
+        return "optimizer";
+    case MemoryPhase::PHASE_RUNTIME:
+        return "runtime";
+    default:
+        return "other";
+    }
+}
+
+// the bookkeeping allocates with malloc so that recording a block never
+// records blocks of its own
+template <typename T>
+struct MallocAllocator
+{
+    typedef T value_type;
+
+    MallocAllocator() = default;
+    template <typename U>
+    MallocAllocator(const MallocAllocator<U> &) {}
+
+    T *allocate(std::size_t n)
+    {
+        auto block = (T *)std::malloc(n * sizeof(T));
+        if (!block)
+            throw std::bad_alloc();
+        return block;
+    }
+    void deallocate(T *block, std::size_t) { std::free(block); }
+
+    template <typename U>
+    bool operator==(const MallocAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const MallocAllocator<U> &) const { return false; }
+};
+
+// the same type name may live at different addresses in different
+// translation units, memoryStats() merges them by their text
+typedef std::pair<MemoryPhase, const char *> TagKey;
+
+struct TagHash
+{
+    std::size_t operator()(const TagKey &key) const
+    {
+        return std::hash<const void *>()(key.second) * 31 + (int)key.first;
+    }
+};
+
+struct Block
+{
+    std::size_t size;
+    MemoryPhase phase;
+    AllocationStats *tag;
+};
+
+static std::atomic<bool> tracking{false};
+static std::mutex lock;
+static AllocationStats total;
+static AllocationStats phases[(int)MemoryPhase::PHASE_COUNT];
+static std::unordered_map<TagKey, AllocationStats, TagHash,
+                          std::equal_to<TagKey>,
+                          MallocAllocator<std::pair<const TagKey,
+                                                    AllocationStats>>>
+    tags;
+static std::unordered_map<void *, Block, std::hash<void *>,
+                          std::equal_to<void *>,
+                          MallocAllocator<std::pair<void *const, Block>>>
+    blocks;
+
+void setMemoryTracking(bool on)
+{
+    tracking.store(on, std::memory_order_relaxed);
+}
+
+bool memoryTracking()
+{
+    return tracking.load(std::memory_order_relaxed);
+}
+
+static void add(AllocationStats &stats, std::int64_t size)
+{
+    stats.count++;
+    stats.bytes += size;
+    stats.live += size;
+    stats.peak = std::max(stats.peak, stats.live);
+}
+
+void recordAllocation(void *block, std::size_t size)
+{
+    auto tag = memoryTag;
+    std::lock_guard<std::mutex> guard(lock);
+    auto &stats = tags[TagKey(tag.phase, tag.type)];
+    add(stats, size);
+    add(phases[(int)tag.phase], size);
+    add(total, size);
+    blocks[block] = Block{size, tag.phase, &stats};
+}
+
+void recordDeallocation(void *block)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = blocks.find(block);
+    if (it == blocks.end())
+        return;
+    auto size = it->second.size;
+    it->second.tag->live -= size;
+    phases[(int)it->second.phase].live -= size;
+    total.live -= size;
+    blocks.erase(it);
+}
+
+MemoryStats memoryStats()
+{
+    MemoryStats stats;
+    // nothing the lock is held for may go through operator new, that would
+    // come back here to record it
+    std::vector<std::pair<TagKey, AllocationStats>,
+                MallocAllocator<std::pair<TagKey, AllocationStats>>>
+        copied;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stats.total = total;
+        std::copy(phases, phases + (int)MemoryPhase::PHASE_COUNT,
+                  stats.phases);
+        copied.assign(tags.begin(), tags.end());
+    }
+
+    std::map<std::pair<MemoryPhase, std::string>, AllocationStats> merged;
+    for (auto &entry : copied)
+    {
+        auto &into = merged[{entry.first.first,
+                             entry.first.second ? entry.first.second : ""}];
+        // peaks of the same type in different translation units may not
+        // have been at the same time, their sum is an upper bound
+        into.count += entry.second.count;
+        into.bytes += entry.second.bytes;
+        into.live += entry.second.live;
+        into.peak += entry.second.peak;
+    }
+    for (auto &entry : merged)
+        stats.types.push_back(
+            TypeStats{entry.first.first, entry.first.second, entry.second});
+    std::stable_sort(stats.types.begin(), stats.types.end(),
+                     [](const TypeStats &a, const TypeStats &b)
+                     {
+                         if (a.phase != b.phase)
+                             return a.phase < b.phase;
+                         return a.stats.bytes > b.stats.bytes;
+                     });
+    return stats;
+}
+
+static void printStats(std::ostream &out, const AllocationStats &stats,
+                       const std::string &name)
+{
+    out << std::setw(12) << stats.count << std::setw(14) << stats.bytes
+        << std::setw(14) << stats.peak << std::setw(14) << stats.live << "  "
+        << name << std::endl;
+}
+
+void printMemoryStats(std::ostream &out, const MemoryStats &stats)
+{
+    out << "===== memory =====" << std::endl;
+    out << std::setw(12) << "allocations" << std::setw(14) << "bytes"
+        << std::setw(14) << "peak bytes" << std::setw(14) << "live bytes"
+        << "  phase / type" << std::endl;
+    for (int phase = 0; phase < (int)MemoryPhase::PHASE_COUNT; phase++)
+    {
+        if (!stats.phases[phase].count)
+            continue;
+        printStats(out, stats.phases[phase],
+                   memoryPhaseName((MemoryPhase)phase));
+        for (auto &entry : stats.types)
+            if ((int)entry.phase == phase)
+                printStats(out, entry.stats,
+                           "  " + (entry.type != "" ? entry.type
+                                                    : std::string("(other)")));
+    }
+    printStats(out, stats.total, "total");
+    out << "===== end of memory =====" << std::endl;
+}
+
+} // namespace sweet
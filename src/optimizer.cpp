@@ -0,0 +1,126 @@
+#include <algorithm>
+
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Optimizer
+// ==================================================
+
+Optimizer::Optimizer(const Program &program, const SourceProfile *profile)
+    : profile{profile}
+{
+    MemoryScope scope(MemoryPhase::PHASE_OPTIMIZER, "Program");
+    this->program = std::make_shared<Program>(program);
+}
+
+// variable slots `program` reads or writes
+static int variablesUsed(const Program &program)
+{
+    std::vector<bool> used(program.constantBase());
+    for (auto &ins : program.code)
+    {
+        int slots[3];
+        int count = usedSlots(ins, slots);
+        slots[count++] = definedSlot(ins);
+        for (int s = 0; s < count; s++)
+            if (slots[s] >= 0 && !program.isConstant(slots[s]))
+                used[slots[s]] = true;
+    }
+    return std::count(used.begin(), used.end(), true);
+}
+
+OptimizerResult Optimizer::optimize()
+{
+    MemoryScope scope(MemoryPhase::PHASE_OPTIMIZER);
+    results.values.instructions[0] = program->code.size();
+    results.values.variables[0] = variablesUsed(*program);
+    // the copies it leaves behind are mostly dead stores for the passes
+    // below to remove
+    numberValues();
+    // removing a store can leave the stores feeding it dead as well
+    bool changed = true;
+    while (changed)
+    {
+        changed = eliminateUnreachable();
+        changed |= eliminateDeadStores();
+    }
+    // OP_LOOP reads and writes variables the dead store elimination can not
+    // see, so this has to come after it
+    optimizeLoops();
+    // checks and branches the ranges show can not fail or go one way only,
+    // dropping the latter can leave code unreachable
+    if (narrowRanges())
+    {
+        changed = true;
+        while (changed)
+            changed = eliminateUnreachable();
+    }
+    // last, as it moves code around the passes above look for in order
+    layoutBlocks();
+    results.values.instructions[1] = program->code.size();
+    results.values.variables[1] = variablesUsed(*program);
+
+    std::stable_sort(results.remarks.begin(), results.remarks.end(),
+                     [](const Remark &a, const Remark &b)
+                     { return a.startPos.idx < b.startPos.idx; });
+    results.value = program;
+    return results;
+}
+
+void Optimizer::removeInstructions(const std::vector<bool> &removed)
+{
+    auto &code = program->code;
+    std::vector<int> newIndex(code.size() + 1);
+    int kept = 0;
+    for (int i = 0; i < code.size(); i++)
+    {
+        newIndex[i] = kept;
+        if (!removed[i])
+            code[kept++] = code[i];
+    }
+    newIndex[code.size()] = kept;
+    code.resize(kept);
+    for (auto &ins : code)
+    {
+        if (isJump(ins.op))
+            ins.target = newIndex[ins.target];
+    }
+}
+
+void Optimizer::insertInstructions(int at,
+                                   const std::vector<Instruction> &inserted,
+                                   bool entry)
+{
+    auto &code = program->code;
+    int count = inserted.size();
+    for (auto &ins : code)
+    {
+        if (isJump(ins.op) &&
+            (ins.target > at || (ins.target == at && !entry)))
+            ins.target += count;
+    }
+    code.insert(code.begin() + at, inserted.begin(), inserted.end());
+}
+
+int Optimizer::constant(Value value)
+{
+    for (int i = 0; i < program->constants.size(); i++)
+        if (program->constants[i] == value)
+            return program->constantBase() + i;
+    program->constants.push_back(value);
+    return program->slotCount() - 1;
+}
+
+void Optimizer::remark(int stmt, std::string details)
+{
+    if (stmt < 0)
+        return;
+    auto &info = program->statements[stmt];
+    results.remarks.push_back(Remark(details, info.startPos, info.endPos));
+}
+
+} // namespace sweet
@@ -0,0 +1,158 @@
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "sweet/lexer.hpp"
+#include "sweet/parser.hpp"
+#include "sweet/pipeline.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Pipeline
+// ==================================================
+
+// the program read so far and the run of it
+struct Pipeline
+{
+    Pipeline(std::ostream &out, std::int64_t fuel)
+        : context(compiler.current(), out), fuel{fuel} {}
+
+    // compiles and runs one more statement, false once the run is over
+    bool step(AstStatement *statement, PipelineResult &result)
+    {
+        result.errors = compiler.append(statement);
+        if (result.errors.size())
+            return false;
+        auto &program = compiler.current();
+        context.slots.resize(program.slotCount());
+        for (auto &literal : compiler.takeLiterals())
+            context.slots[literal.first] = literal.second;
+
+        if (waiting != "")
+        {
+            int label = compiler.labelAt(waiting);
+            if (label < 0)
+                return forget();
+            waiting = "";
+            context.pc = label;
+        }
+
+        auto run = fuel >= 0 ? sweet::run(context, fuel) : sweet::run(context);
+        fuel = run.fuel;
+        if (run.status != RunStatus::FINISHED)
+        {
+            result.status = run.status;
+            if (run.status == RunStatus::ERROR)
+                result.errors.push_back(run.error);
+            return false;
+        }
+        if (context.pc != program.code.size() - 1)
+            waiting = *compiler.waitsFor(context.pc);
+        return forget();
+    }
+
+    // once the end of the input has been read
+    void finish(PipelineResult &result)
+    {
+        result.errors = compiler.unresolved();
+    }
+
+private:
+    // code already run is only kept for the labels in it, a run that is
+    // waiting never goes back into what it skipped either
+    bool forget()
+    {
+        if (!compiler.hasLabels())
+        {
+            compiler.forget();
+            context.pc = 0;
+        }
+        return true;
+    }
+
+    Compiler compiler;
+    Context context;
+    std::int64_t fuel;
+    std::string waiting; // label a goto is waiting for
+};
+
+// lexes and parses `text`, which holds at most one statement, as the input
+// from `pos` on, leaving `pos` past it; null when it is only whitespace or
+// has errors, which go to `errors`
+static std::shared_ptr<AstProgram> parseStatement(Position &pos,
+                                                  const std::string &text,
+                                                  std::vector<Error> &errors)
+{
+    Lexer lexer(pos, text);
+    auto lexerResult = lexer.tokenize();
+    for (auto c : text)
+        pos.advance(c);
+    if (lexerResult.errors.size())
+    {
+        errors = lexerResult.errors;
+        return nullptr;
+    }
+    if (lexerResult.value.empty())
+        return nullptr;
+    Parser parser(std::move(lexerResult.value));
+    auto parserResult = parser.parse();
+    errors = parserResult.errors;
+    return parserResult.value;
+}
+
+PipelineResult runPipeline(int input, const std::string &inputName,
+                           std::ostream &out, const PipelineOptions &options)
+{
+    PipelineResult result;
+    Pipeline pipeline(out, options.fuel);
+    Position pos(inputName);
+    std::string buffer, text;
+    std::size_t start = 0;
+    char chunk[1 << 16];
+    for (;;)
+    {
+        // every ';' ends a statement, there is nothing it could be part of
+        auto semicolon = buffer.find(';', start);
+        if (semicolon != std::string::npos)
+        {
+            text.assign(buffer, start, semicolon + 1 - start);
+            start = semicolon + 1;
+            auto ast = parseStatement(pos, text, result.errors);
+            if (result.errors.size())
+                return result;
+            if (ast && !pipeline.step(ast->statements[0], result))
+                return result;
+            continue;
+        }
+
+        out.flush();
+        buffer.erase(0, start);
+        start = 0;
+        auto count = read(input, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+        {
+            result.errors.push_back(Error(
+                ErrorType::INPUT_ERROR,
+                std::string("could not read the program: ") + strerror(errno) +
+                    ".",
+                pos, pos));
+            return result;
+        }
+        if (count == 0)
+            break;
+        buffer.append(chunk, count);
+    }
+
+    // whatever follows the last ';' can only be an unfinished statement
+    parseStatement(pos, buffer, result.errors);
+    if (result.errors.empty())
+        pipeline.finish(result);
+    return result;
+}
+
+} // namespace sweet
@@ -0,0 +1,183 @@
+#include "sweet/memory.hpp"
+#include "sweet/printer.hpp"
+
+namespace sweet
+{
+
+void printAstVariable(std::ostream &out, AstVariable *variable,
+                      std::string prefix)
+{
+    out << "AstVariable" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << variable->tokenVariable << std::endl;
+}
+
+void printAstLiteral(std::ostream &out, AstLiteral *literal, std::string prefix)
+{
+    out << "AstLiteral" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << literal->tokenLiteral << std::endl;
+}
+
+void printAstPrimary(std::ostream &out, AstPrimary *primary, std::string prefix)
+{
+    out << "AstPrimary" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    switch (primary->type)
+    {
+    case AstType::AST_VARIABLE:
+        printAstVariable(out, primary->astVariable, prefix + "  ");
+        break;
+    case AstType::AST_LITERAL:
+        printAstLiteral(out, primary->astLiteral, prefix + "  ");
+        break;
+    default:
+        break;
+    }
+}
+
+void printAstExpression(std::ostream &out, AstExpression *expression,
+                        std::string prefix)
+{
+    out << "AstExpression" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    auto tempPrefix = expression->right ? prefix + "| " : prefix + "  ";
+    printAstPrimary(out, expression->left, tempPrefix);
+    if (expression->right)
+    {
+        out << prefix << "| " << std::endl;
+        out << prefix << "+-" << expression->tokenOperator << std::endl;
+        out << prefix << "| " << std::endl;
+        out << prefix << "+-";
+        printAstPrimary(out, expression->right, prefix + "  ");
+    }
+}
+
+void printAstGoto(std::ostream &out, AstGoto *astGoto, std::string prefix)
+{
+    out << "AstGoto" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << astGoto->tokenGoto << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    printAstVariable(out, astGoto->astVariable, prefix + "| ");
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << astGoto->tokenSemiColon << std::endl;
+}
+
+void printAstLabel(std::ostream &out, AstLabel *label, std::string prefix)
+{
+    out << "AstLabel" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << label->tokenLabel << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    printAstVariable(out, label->astVariable, prefix + "| ");
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << label->tokenSemiColon << std::endl;
+}
+
+void printAstPrint(std::ostream &out, AstPrint *print, std::string prefix)
+{
+    out << "AstPrint" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << print->tokenPrint << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    printAstExpression(out, print->astExpression, prefix + "| ");
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << print->tokenSemiColon << std::endl;
+}
+
+void printAstAssign(std::ostream &out, AstAssign *assign, std::string prefix)
+{
+    out << "AstAssign" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    printAstVariable(out, assign->astVariable, prefix + "| ");
+    out << prefix << "|" << std::endl;
+    out << prefix << "+-" << assign->tokenEqual << std::endl;
+    out << prefix << "|" << std::endl;
+    out << prefix << "+-";
+    printAstExpression(out, assign->astExpression, prefix + "| ");
+    out << prefix << "|" << std::endl;
+    out << prefix << "+-" << assign->tokenSemiColon << std::endl;
+}
+
+// everything of an if up to its body
+static void printAstIfHeader(std::ostream &out, AstIf *astIf,
+                             const std::string &prefix)
+{
+    out << "AstIf" << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << astIf->tokenIf << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << astIf->tokenLParen << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+    printAstExpression(out, astIf->astExpression, prefix + "| ");
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-" << astIf->tokenRParen << std::endl;
+    out << prefix << "| " << std::endl;
+    out << prefix << "+-";
+}
+
+void printAstIf(std::ostream &out, AstIf *astIf, std::string prefix)
+{
+    printAstIfHeader(out, astIf, prefix);
+    printAstStatement(out, astIf->astStatement, prefix + "  ");
+}
+
+void printAstStatement(std::ostream &out, AstStatement *statement,
+                       std::string prefix)
+{
+    // nested ifs are printed in a loop, so that a deep chain of them does not
+    // recurse once per level
+    for (;;)
+    {
+        out << "AstStatement" << std::endl;
+        out << prefix << "| " << std::endl;
+        out << prefix << "+-";
+        if (statement->type != AstType::AST_IF)
+            break;
+        prefix += "  ";
+        printAstIfHeader(out, statement->astIf, prefix);
+        prefix += "  ";
+        statement = statement->astIf->astStatement;
+    }
+    switch (statement->type)
+    {
+    case AstType::AST_PRINT:
+        printAstPrint(out, statement->astPrint, prefix + "  ");
+        break;
+    case AstType::AST_GOTO:
+        printAstGoto(out, statement->astGoto, prefix + "  ");
+        break;
+    case AstType::AST_ASSIGN:
+        printAstAssign(out, statement->astAssign, prefix + "  ");
+        break;
+    case AstType::AST_LABEL:
+        printAstLabel(out, statement->astLabel, prefix + "  ");
+        break;
+    default:
+        break;
+    }
+}
+
+void printAstProgram(std::ostream &out, AstProgram *program, std::string prefix)
+{
+    MemoryScope scope(MemoryPhase::PHASE_PRINTER);
+    out << "AstProgram" << std::endl;
+    for (int i = 0; i < program->statements.size(); i++)
+    {
+        out << prefix << "| " << std::endl;
+        out << prefix << "+-";
+        auto tempPrefix = (i == program->statements.size() - 1 ? prefix + "  "
+                                                               : prefix + "| ");
+        printAstStatement(out, program->statements[i], tempPrefix);
+    }
+}
+
+} // namespace sweet
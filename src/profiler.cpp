@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "sweet/profiler.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Profiler
+// ==================================================
+
+Profile::Profile(const Program &program, int period)
+    : counts(program.code.size()), jumps(program.code.size()),
+      ticks(program.code.size()), samples(program.code.size()),
+      period{std::max(period, 1)}, overhead{~0ull}
+{
+    // the smallest of a few back to back readings is what every sample pays
+    // on top of the instruction it times
+    for (int i = 0; i < 64; i++)
+    {
+        auto start = clockTicks();
+        overhead = std::min(overhead, clockTicks() - start);
+    }
+}
+
+std::vector<StatementProfile> summarize(const Program &program,
+                                        const Profile &profile)
+{
+    // the optimizer can leave more than one copy of a statement, each a run
+    // of instructions of its own, so the counts of every copy add up. The
+    // first jump of a copy of an if is the one its condition decides, a copy
+    // without one never jumped. An OP_LOOP is not part of the statement it is
+    // filed under, it only picks the copy to run
+    auto size = program.statements.size();
+    std::vector<std::uint64_t> counts(size), evaluated(size), jumped(size);
+    std::vector<bool> seen(size);
+    std::vector<double> ticks(size);
+    for (int i = 0; i < program.code.size(); i++)
+    {
+        auto &ins = program.code[i];
+        int stmt = ins.stmt;
+        if (stmt < 0)
+            continue;
+        auto &previous = program.code[i > 0 ? i - 1 : 0];
+        bool loop = ins.op == OpCode::OP_LOOP;
+        if (!loop && (i == 0 || previous.stmt != stmt ||
+                      previous.op == OpCode::OP_LOOP))
+        {
+            seen[stmt] = true;
+            counts[stmt] += profile.counts[i];
+            int branch = i;
+            while (branch < program.code.size() &&
+                   program.code[branch].stmt == stmt &&
+                   !isJump(program.code[branch].op))
+                branch++;
+            if (branch < program.code.size() &&
+                program.code[branch].stmt == stmt)
+            {
+                evaluated[stmt] += profile.counts[branch];
+                jumped[stmt] += profile.jumps[branch];
+            }
+            else
+                evaluated[stmt] += profile.counts[i];
+        }
+        auto spent = profile.ticks[i] -
+                     std::min(profile.ticks[i],
+                              profile.samples[i] * profile.overhead);
+        ticks[stmt] += (double)spent * profile.period;
+    }
+
+    // samples also catch some of the profiler's own work, so the estimates
+    // are scaled to add up to the time the runs actually took
+    double sampled = 0;
+    for (auto spent : ticks)
+        sampled += spent;
+    double nsPerTick = sampled > 0 ? profile.totalNs / sampled : 0;
+    std::vector<StatementProfile> statements;
+    for (int stmt = 0; stmt < program.statements.size(); stmt++)
+    {
+        if (!seen[stmt] || counts[stmt] == 0)
+            continue;
+        StatementProfile entry{stmt, counts[stmt], ticks[stmt] * nsPerTick, 0,
+                               0};
+        auto &info = program.statements[stmt];
+        if (info.type == AstType::AST_IF)
+        {
+            // an if with a goto jumps when it is true, any other if jumps
+            // over its statement when it is false, unless the optimizer
+            // turned the jump around
+            bool jumpsWhenTrue = (info.body < 0) != info.inverted;
+            entry.taken = jumpsWhenTrue ? jumped[stmt]
+                                        : evaluated[stmt] - jumped[stmt];
+            entry.notTaken = evaluated[stmt] - entry.taken;
+        }
+        statements.push_back(entry);
+    }
+
+    std::stable_sort(statements.begin(), statements.end(),
+                     [](const StatementProfile &a, const StatementProfile &b)
+                     {
+                         if (a.ns != b.ns)
+                             return a.ns > b.ns;
+                         return a.count > b.count;
+                     });
+    return statements;
+}
+
+void printProfile(std::ostream &out, const Program &program,
+                  const Profile &profile)
+{
+    auto statements = summarize(program, profile);
+    double total = 0;
+    for (auto &entry : statements)
+        total += entry.ns;
+
+    out << "===== profile =====" << std::endl;
+    out << std::setw(14) << "time (ns)" << std::setw(8) << "%"
+        << std::setw(14) << "count" << "  statement" << std::endl;
+    for (auto &entry : statements)
+    {
+        auto &info = program.statements[entry.stmt];
+        out << std::setw(14) << std::fixed << std::setprecision(0) << entry.ns
+            << std::setw(8) << std::setprecision(1)
+            << (total > 0 ? 100 * entry.ns / total : 0.0)
+            << std::setw(14) << entry.count << "  " << info.startPos << " "
+            << statementName(info.type);
+        if (info.type == AstType::AST_IF)
+            out << " (taken " << entry.taken << ", not taken "
+                << entry.notTaken << ")";
+        out << std::endl;
+    }
+    out << "===== end of profile =====" << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
+
+void printProfileFolded(std::ostream &out, const Program &program,
+                        const Profile &profile)
+{
+    for (auto &entry : summarize(program, profile))
+    {
+        auto &info = program.statements[entry.stmt];
+        out << info.startPos.fname << ";" << info.startPos << " "
+            << statementName(info.type) << " " << (std::uint64_t)entry.ns
+            << std::endl;
+    }
+}
+
+static void printJsonString(std::ostream &out, const std::string &value)
+{
+    out << '"';
+    for (auto c : value)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if ((unsigned char)c < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << (int)c << std::dec << std::setfill(' ');
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+void printProfileJson(std::ostream &out, const Program &program,
+                      const Profile &profile)
+{
+    auto statements = summarize(program, profile);
+    out << "{\"total_ns\": " << profile.totalNs << ", \"statements\": [";
+    for (int i = 0; i < statements.size(); i++)
+    {
+        auto &entry = statements[i];
+        auto &info = program.statements[entry.stmt];
+        out << (i ? ",\n  " : "\n  ") << "{\"file\": ";
+        printJsonString(out, info.startPos.fname);
+        out << ", \"line\": " << info.startPos.ln
+            << ", \"col\": " << info.startPos.col << ", \"kind\": \""
+            << statementName(info.type) << "\", \"count\": " << entry.count
+            << ", \"ns\": " << (std::uint64_t)entry.ns;
+        if (info.type == AstType::AST_IF)
+            out << ", \"taken\": " << entry.taken
+                << ", \"not_taken\": " << entry.notTaken;
+        out << "}";
+    }
+    out << "\n]}" << std::endl;
+}
+
+// ==================================================
+// Source profile
+// ==================================================
+
+const StatementCounts *SourceProfile::find(const StatementInfo &info) const
+{
+    auto it = statements.find({info.startPos.ln, info.startPos.col});
+    if (it == statements.end() || it->second.type != info.type)
+        return nullptr;
+    return &it->second;
+}
+
+std::uint64_t SourceProfile::jumps(const StatementInfo &info) const
+{
+    auto found = find(info);
+    if (!found || info.type != AstType::AST_IF)
+        return 0;
+    bool jumpsWhenTrue = (info.body < 0) != info.inverted;
+    return jumpsWhenTrue ? found->taken : found->notTaken;
+}
+
+SourceProfile sourceProfile(const Program &program, const Profile &profile)
+{
+    SourceProfile source;
+    for (auto &entry : summarize(program, profile))
+    {
+        auto &info = program.statements[entry.stmt];
+        source.statements[{info.startPos.ln, info.startPos.col}] =
+            StatementCounts{info.type, entry.count, entry.taken,
+                            entry.notTaken};
+    }
+    return source;
+}
+
+void writeSourceProfile(std::ostream &out, const SourceProfile &profile)
+{
+    out << "# kind line column count [taken not-taken]" << std::endl;
+    for (auto &entry : profile.statements)
+    {
+        auto &counts = entry.second;
+        out << statementName(counts.type) << " " << entry.first.first << " "
+            << entry.first.second << " " << counts.count;
+        if (counts.type == AstType::AST_IF)
+            out << " " << counts.taken << " " << counts.notTaken;
+        out << std::endl;
+    }
+}
+
+SourceProfileResult readSourceProfile(const std::string &filename,
+                                      const std::string &source)
+{
+    static const AstType kinds[] = {AstType::AST_ASSIGN, AstType::AST_LABEL,
+                                    AstType::AST_GOTO, AstType::AST_IF,
+                                    AstType::AST_PRINT};
+    SourceProfileResult result;
+    std::istringstream lines(source);
+    std::string line;
+    for (int number = 1; std::getline(lines, line); number++)
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string kind, extra;
+        std::pair<int, int> where;
+        StatementCounts counts{AstType::AST_PROGRAM, 0, 0, 0};
+        fields >> kind >> where.first >> where.second >> counts.count;
+        for (auto type : kinds)
+            if (kind == statementName(type))
+                counts.type = type;
+        if (counts.type == AstType::AST_IF)
+            fields >> counts.taken >> counts.notTaken;
+        if (!fields || counts.type == AstType::AST_PROGRAM ||
+            (fields >> extra))
+        {
+            Position start(filename, 0, number, first + 1);
+            Position end(filename, 0, number, line.size() + 1);
+            result.errors.push_back(Error(
+                ErrorType::INPUT_ERROR,
+                "expected a kind of statement, a line, a column and counts.",
+                start, end));
+            continue;
+        }
+        result.value.statements[where] = counts;
+    }
+    return result;
+}
+
+} // namespace sweet
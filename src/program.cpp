@@ -0,0 +1,271 @@
+#include <iomanip>
+
+#include "sweet/program.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Program
+// ==================================================
+
+const char *opCodeName(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_MOVE:
+        return "MOVE";
+    case OpCode::OP_ADD:
+        return "ADD";
+    case OpCode::OP_SUB:
+        return "SUB";
+    case OpCode::OP_MUL:
+        return "MUL";
+    case OpCode::OP_DIV:
+        return "DIV";
+    case OpCode::OP_ADD_UNCHECKED:
+        return "ADD_UNCHECKED";
+    case OpCode::OP_SUB_UNCHECKED:
+        return "SUB_UNCHECKED";
+    case OpCode::OP_MUL_UNCHECKED:
+        return "MUL_UNCHECKED";
+    case OpCode::OP_DIV_UNCHECKED:
+        return "DIV_UNCHECKED";
+    case OpCode::OP_EQ:
+        return "EQ";
+    case OpCode::OP_LT:
+        return "LT";
+    case OpCode::OP_LE:
+        return "LE";
+    case OpCode::OP_GT:
+        return "GT";
+    case OpCode::OP_GE:
+        return "GE";
+    case OpCode::OP_PRINT:
+        return "PRINT";
+    case OpCode::OP_JUMP:
+        return "JUMP";
+    case OpCode::OP_JUMP_EQ:
+        return "JUMP_EQ";
+    case OpCode::OP_JUMP_NE:
+        return "JUMP_NE";
+    case OpCode::OP_JUMP_LT:
+        return "JUMP_LT";
+    case OpCode::OP_JUMP_LE:
+        return "JUMP_LE";
+    case OpCode::OP_JUMP_GT:
+        return "JUMP_GT";
+    case OpCode::OP_JUMP_GE:
+        return "JUMP_GE";
+    case OpCode::OP_LOOP:
+        return "LOOP";
+    case OpCode::OP_HALT:
+        return "HALT";
+    }
+    return "UNKNOWN";
+}
+
+const char *statementName(AstType type)
+{
+    switch (type)
+    {
+    case AstType::AST_ASSIGN:
+        return "assign";
+    case AstType::AST_LABEL:
+        return "label";
+    case AstType::AST_GOTO:
+        return "goto";
+    case AstType::AST_IF:
+        return "if";
+    case AstType::AST_PRINT:
+        return "print";
+    default:
+        return "statement";
+    }
+}
+
+bool isJump(OpCode op)
+{
+    return op == OpCode::OP_JUMP || op == OpCode::OP_LOOP || isBranch(op);
+}
+
+bool isBranch(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_JUMP_EQ:
+    case OpCode::OP_JUMP_NE:
+    case OpCode::OP_JUMP_LT:
+    case OpCode::OP_JUMP_LE:
+    case OpCode::OP_JUMP_GT:
+    case OpCode::OP_JUMP_GE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+OpCode negatedBranch(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_JUMP_EQ:
+        return OpCode::OP_JUMP_NE;
+    case OpCode::OP_JUMP_NE:
+        return OpCode::OP_JUMP_EQ;
+    case OpCode::OP_JUMP_LT:
+        return OpCode::OP_JUMP_GE;
+    case OpCode::OP_JUMP_LE:
+        return OpCode::OP_JUMP_GT;
+    case OpCode::OP_JUMP_GT:
+        return OpCode::OP_JUMP_LE;
+    default:
+        return OpCode::OP_JUMP_LT;
+    }
+}
+
+bool isBinary(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_ADD:
+    case OpCode::OP_SUB:
+    case OpCode::OP_MUL:
+    case OpCode::OP_DIV:
+    case OpCode::OP_ADD_UNCHECKED:
+    case OpCode::OP_SUB_UNCHECKED:
+    case OpCode::OP_MUL_UNCHECKED:
+    case OpCode::OP_DIV_UNCHECKED:
+    case OpCode::OP_EQ:
+    case OpCode::OP_LT:
+    case OpCode::OP_LE:
+    case OpCode::OP_GT:
+    case OpCode::OP_GE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int definedSlot(const Instruction &ins)
+{
+    if (ins.op == OpCode::OP_MOVE || isBinary(ins.op))
+        return ins.dst;
+    return -1;
+}
+
+int usedSlots(const Instruction &ins, int used[2])
+{
+    if (isBinary(ins.op) || isBranch(ins.op))
+    {
+        used[0] = ins.a;
+        used[1] = ins.b;
+        return 2;
+    }
+    if (ins.op == OpCode::OP_MOVE || ins.op == OpCode::OP_PRINT)
+    {
+        used[0] = ins.a;
+        return 1;
+    }
+    return 0;
+}
+
+bool canTrap(const Program &program, const Instruction &ins)
+{
+    switch (ins.op)
+    {
+    case OpCode::OP_ADD:
+    case OpCode::OP_SUB:
+    case OpCode::OP_MUL:
+    {
+        if (!program.isConstant(ins.a) || !program.isConstant(ins.b))
+            return true;
+        Value a = program.constantValue(ins.a);
+        Value b = program.constantValue(ins.b);
+        Value result;
+        if (ins.op == OpCode::OP_ADD)
+            return __builtin_add_overflow(a, b, &result);
+        if (ins.op == OpCode::OP_SUB)
+            return __builtin_sub_overflow(a, b, &result);
+        return __builtin_mul_overflow(a, b, &result);
+    }
+    case OpCode::OP_DIV:
+    {
+        // any constant divisor but 0 and -1 is safe whatever it divides
+        if (!program.isConstant(ins.b))
+            return true;
+        Value b = program.constantValue(ins.b);
+        if (b == 0)
+            return true;
+        if (b != -1)
+            return false;
+        return !program.isConstant(ins.a) ||
+               program.constantValue(ins.a) == INT64_MIN;
+    }
+    default:
+        return false;
+    }
+}
+
+static void printSlot(std::ostream &out, const Program &program, int slot)
+{
+    if (program.isConstant(slot))
+        out << program.constantValue(slot);
+    else
+        out << program.names[slot];
+}
+
+void printProgram(std::ostream &out, const Program &program)
+{
+    for (int i = 0; i < program.code.size(); i++)
+    {
+        auto &ins = program.code[i];
+        out << std::setw(4) << std::setfill('0') << i << std::setfill(' ')
+            << "  " << std::left << std::setw(14) << opCodeName(ins.op)
+            << std::right;
+        switch (ins.op)
+        {
+        case OpCode::OP_MOVE:
+            printSlot(out, program, ins.dst);
+            out << ", ";
+            printSlot(out, program, ins.a);
+            break;
+        case OpCode::OP_PRINT:
+            printSlot(out, program, ins.a);
+            break;
+        case OpCode::OP_JUMP:
+            out << ins.target;
+            break;
+        case OpCode::OP_LOOP:
+            out << "#" << ins.a << (program.loops[ins.a].closed ? " closed"
+                                                               : " reduced")
+                << ", " << ins.target;
+            break;
+        case OpCode::OP_HALT:
+            break;
+        case OpCode::OP_JUMP_EQ:
+        case OpCode::OP_JUMP_NE:
+        case OpCode::OP_JUMP_LT:
+        case OpCode::OP_JUMP_LE:
+        case OpCode::OP_JUMP_GT:
+        case OpCode::OP_JUMP_GE:
+            printSlot(out, program, ins.a);
+            out << ", ";
+            printSlot(out, program, ins.b);
+            out << ", " << ins.target;
+            break;
+        default:
+            printSlot(out, program, ins.dst);
+            out << ", ";
+            printSlot(out, program, ins.a);
+            out << ", ";
+            printSlot(out, program, ins.b);
+            break;
+        }
+        if (ins.stmt >= 0)
+            out << "  ; " << program.statements[ins.stmt].startPos;
+        out << std::endl;
+    }
+}
+
+} // namespace sweet
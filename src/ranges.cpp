@@ -0,0 +1,573 @@
+#include <algorithm>
+#include <iomanip>
+#include <set>
+
+#include "sweet/cfg.hpp"
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Value range analysis
+// ==================================================
+
+typedef __int128 Wide;
+
+static Value saturate(Wide value)
+{
+    return value < INT64_MIN ? INT64_MIN
+                             : value > INT64_MAX ? INT64_MAX : (Value)value;
+}
+
+static bool fits(Wide value)
+{
+    return value >= INT64_MIN && value <= INT64_MAX;
+}
+
+static ValueRange exactly(Value value)
+{
+    return ValueRange{value, value};
+}
+
+static ValueRange hull(const ValueRange &a, const ValueRange &b)
+{
+    if (a.empty())
+        return b;
+    if (b.empty())
+        return a;
+    return ValueRange{std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+static bool contains(const ValueRange &range, Value value)
+{
+    return range.lo <= value && value <= range.hi;
+}
+
+// the bounds of `a op b` over every pair of values in the ranges, for the
+// operations whose extremes lie at the corners; `exact` is cleared when one
+// of them does not fit in 64 bits
+static ValueRange corners(OpCode op, const ValueRange &a, const ValueRange &b,
+                          bool &exact)
+{
+    Wide lo = 0, hi = 0;
+    bool first = true;
+    for (Wide x : {a.lo, a.hi})
+        for (Wide y : {b.lo, b.hi})
+        {
+            Wide value = op == OpCode::OP_ADD   ? x + y
+                         : op == OpCode::OP_SUB ? x - y
+                         : op == OpCode::OP_MUL ? x * y
+                                                : x / y;
+            lo = first ? value : std::min(lo, value);
+            hi = first ? value : std::max(hi, value);
+            first = false;
+        }
+    exact = fits(lo) && fits(hi);
+    return ValueRange{saturate(lo), saturate(hi)};
+}
+
+// a / b for the divisors of `b` other than zero, `exact` as for corners()
+static ValueRange divide(const ValueRange &a, const ValueRange &b, bool &exact)
+{
+    // on either side of zero the quotient is monotonic in both operands
+    ValueRange result{1, 0};
+    exact = true;
+    for (auto side : {ValueRange{b.lo, std::min(b.hi, (Value)-1)},
+                      ValueRange{std::max(b.lo, (Value)1), b.hi}})
+    {
+        if (side.empty())
+            continue;
+        bool fitted;
+        result = hull(result, corners(OpCode::OP_DIV, a, side, fitted));
+        exact &= fitted;
+    }
+    return result;
+}
+
+// the branch that jumps when the comparison `op` holds
+static OpCode branchOf(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_EQ:
+        return OpCode::OP_JUMP_EQ;
+    case OpCode::OP_LT:
+        return OpCode::OP_JUMP_LT;
+    case OpCode::OP_LE:
+        return OpCode::OP_JUMP_LE;
+    case OpCode::OP_GT:
+        return OpCode::OP_JUMP_GT;
+    case OpCode::OP_GE:
+        return OpCode::OP_JUMP_GE;
+    default:
+        return op;
+    }
+}
+
+// 1 when `a branch b` holds for every pair of values, 0 when it never does,
+// -1 when it depends
+static int decide(OpCode branch, const ValueRange &a, const ValueRange &b)
+{
+    switch (branch)
+    {
+    case OpCode::OP_JUMP_EQ:
+        if (a.lo == a.hi && b.lo == b.hi && a.lo == b.lo)
+            return 1;
+        return a.hi < b.lo || b.hi < a.lo ? 0 : -1;
+    case OpCode::OP_JUMP_NE:
+    {
+        int equal = decide(OpCode::OP_JUMP_EQ, a, b);
+        return equal < 0 ? -1 : !equal;
+    }
+    case OpCode::OP_JUMP_LT:
+        return a.hi < b.lo ? 1 : a.lo >= b.hi ? 0 : -1;
+    case OpCode::OP_JUMP_LE:
+        return a.hi <= b.lo ? 1 : a.lo > b.hi ? 0 : -1;
+    case OpCode::OP_JUMP_GT:
+        return decide(OpCode::OP_JUMP_LT, b, a);
+    default:
+        return decide(OpCode::OP_JUMP_LE, b, a);
+    }
+}
+
+// narrows `a` and `b` to the values for which `a branch b` can hold
+static void refine(OpCode branch, ValueRange &a, ValueRange &b)
+{
+    auto oldA = a, oldB = b;
+    switch (branch)
+    {
+    case OpCode::OP_JUMP_EQ:
+        a.lo = b.lo = std::max(oldA.lo, oldB.lo);
+        a.hi = b.hi = std::min(oldA.hi, oldB.hi);
+        break;
+    case OpCode::OP_JUMP_NE:
+        // only a single value on one side can be cut off the other
+        if (oldB.lo == oldB.hi)
+        {
+            if (a.lo == oldB.lo)
+                a.lo = saturate((Wide)a.lo + 1);
+            else if (a.hi == oldB.lo)
+                a.hi = saturate((Wide)a.hi - 1);
+        }
+        if (oldA.lo == oldA.hi)
+        {
+            if (b.lo == oldA.lo)
+                b.lo = saturate((Wide)b.lo + 1);
+            else if (b.hi == oldA.lo)
+                b.hi = saturate((Wide)b.hi - 1);
+        }
+        if (oldA.lo == oldA.hi && oldB.lo == oldB.hi && oldA.lo == oldB.lo)
+            a = b = ValueRange{1, 0};
+        break;
+    case OpCode::OP_JUMP_LT:
+        if (oldB.hi == INT64_MIN || oldA.lo == INT64_MAX)
+        {
+            a = b = ValueRange{1, 0};
+            break;
+        }
+        a.hi = std::min(oldA.hi, oldB.hi - 1);
+        b.lo = std::max(oldB.lo, oldA.lo + 1);
+        break;
+    case OpCode::OP_JUMP_LE:
+        a.hi = std::min(oldA.hi, oldB.hi);
+        b.lo = std::max(oldB.lo, oldA.lo);
+        break;
+    case OpCode::OP_JUMP_GT:
+        refine(OpCode::OP_JUMP_LT, b, a);
+        break;
+    default:
+        refine(OpCode::OP_JUMP_LE, b, a);
+        break;
+    }
+}
+
+namespace
+{
+
+// the ranges of the variables where a block starts, none of them while
+// nothing reaches it
+struct RangeState
+{
+    bool reached = false;
+    std::vector<ValueRange> slots;
+};
+
+struct RangeAnalysis
+{
+    RangeAnalysis(const Program &program, const Cfg &cfg)
+        : program{program}, cfg{cfg}, in(cfg.blocks.size())
+    {
+    }
+
+    ValueRange get(const RangeState &state, int slot) const
+    {
+        if (program.isConstant(slot))
+            return exactly(program.constantValue(slot));
+        return state.slots[slot];
+    }
+
+    // the value `ins` stores given `state` before it; `safe` is set when it
+    // can not fail
+    ValueRange result(const RangeState &state, const Instruction &ins,
+                      bool &safe) const
+    {
+        auto a = get(state, ins.a);
+        auto b = isBinary(ins.op) ? get(state, ins.b) : ValueRange();
+        bool exact = true;
+        ValueRange value;
+        safe = true;
+        switch (ins.op)
+        {
+        case OpCode::OP_MOVE:
+            return a;
+        case OpCode::OP_ADD:
+        case OpCode::OP_SUB:
+        case OpCode::OP_MUL:
+            // a result that does not fit stops the program instead
+            value = corners(ins.op, a, b, exact);
+            safe = exact;
+            return value;
+        case OpCode::OP_ADD_UNCHECKED:
+        case OpCode::OP_SUB_UNCHECKED:
+        case OpCode::OP_MUL_UNCHECKED:
+        {
+            auto checked = ins.op == OpCode::OP_ADD_UNCHECKED ? OpCode::OP_ADD
+                           : ins.op == OpCode::OP_SUB_UNCHECKED
+                               ? OpCode::OP_SUB
+                               : OpCode::OP_MUL;
+            value = corners(checked, a, b, exact);
+            // it wraps around where it does not
+            return exact ? value : ValueRange();
+        }
+        case OpCode::OP_DIV:
+        case OpCode::OP_DIV_UNCHECKED:
+            value = divide(a, b, exact);
+            safe = exact && !contains(b, 0);
+            return value;
+        default:
+        {
+            int holds = decide(branchOf(ins.op), a, b);
+            return holds < 0 ? ValueRange{0, 1} : exactly(holds);
+        }
+        }
+    }
+
+    // runs `state` through the instructions of `block` but the last
+    void transfer(int block, RangeState &state) const
+    {
+        auto &bb = cfg.blocks[block];
+        for (int i = bb.start; i < bb.end - 1; i++)
+            step(state, program.code[i]);
+    }
+
+    void step(RangeState &state, const Instruction &ins) const
+    {
+        int dst = definedSlot(ins);
+        if (dst < 0)
+            return;
+        bool safe;
+        state.slots[dst] = result(state, ins, safe);
+    }
+
+    // hands the state leaving `block` along every edge to `to(block, state)`
+    template <typename To>
+    void leave(int block, RangeState state, To to) const
+    {
+        if (!state.reached)
+            return;
+        transfer(block, state);
+        auto &bb = cfg.blocks[block];
+        auto &ins = program.code[bb.end - 1];
+        int next = bb.end < program.code.size() ? cfg.blockOf[bb.end] : -1;
+        int target = isJump(ins.op) ? cfg.blockOf[ins.target] : -1;
+
+        if (isBranch(ins.op))
+        {
+            for (bool taken : {true, false})
+            {
+                auto edge = state;
+                auto branch = taken ? ins.op : negatedBranch(ins.op);
+                auto a = get(state, ins.a), b = get(state, ins.b);
+                if (ins.a == ins.b)
+                {
+                    if (decide(branch, exactly(0), exactly(0)) == 0)
+                        continue;
+                }
+                else
+                {
+                    refine(branch, a, b);
+                    if (a.empty() || b.empty())
+                        continue;
+                    if (!program.isConstant(ins.a))
+                        edge.slots[ins.a] = a;
+                    if (!program.isConstant(ins.b))
+                        edge.slots[ins.b] = b;
+                }
+                to(taken ? target : next, edge);
+            }
+            return;
+        }
+        if (ins.op == OpCode::OP_LOOP)
+        {
+            // the loop may have run any number of times, or not at all
+            auto &loop = program.loops[ins.a];
+            for (auto &linear : loop.linear)
+                state.slots[linear.slot] = ValueRange();
+            for (auto &sum : loop.sums)
+                state.slots[sum.slot] = ValueRange();
+            for (auto &product : loop.products)
+                state.slots[product.slot] = ValueRange();
+            to(target, state);
+            to(next, state);
+            return;
+        }
+        if (ins.op == OpCode::OP_HALT)
+            return;
+        step(state, ins);
+        to(ins.op == OpCode::OP_JUMP ? target : next, state);
+    }
+
+    // iterates to a fixpoint, widening the bounds that still move at the
+    // blocks loops jump back to, then narrows them back down a few times
+    void solve()
+    {
+        int blocks = cfg.blocks.size();
+        int variables = program.constantBase();
+        std::vector<bool> loopHead(blocks);
+        for (int b = 0; b < blocks; b++)
+            for (int pred : cfg.blocks[b].preds)
+                if (pred >= b)
+                    loopHead[b] = true;
+
+        // variables start out with whatever the embedder put in them
+        in[0].reached = true;
+        in[0].slots.assign(variables, ValueRange());
+        std::vector<int> visits(blocks);
+        std::set<int> work{0};
+        while (!work.empty())
+        {
+            int block = *work.begin();
+            work.erase(work.begin());
+            leave(block, in[block],
+                  [&](int to, const RangeState &state)
+                  {
+                      auto &into = in[to];
+                      if (!into.reached)
+                      {
+                          into = state;
+                          work.insert(to);
+                          return;
+                      }
+                      bool widen = loopHead[to] && ++visits[to] > 2;
+                      bool changed = false;
+                      for (int s = 0; s < variables; s++)
+                      {
+                          auto merged = hull(into.slots[s], state.slots[s]);
+                          if (widen && merged.lo < into.slots[s].lo)
+                              merged.lo = INT64_MIN;
+                          if (widen && merged.hi > into.slots[s].hi)
+                              merged.hi = INT64_MAX;
+                          if (merged.lo != into.slots[s].lo ||
+                              merged.hi != into.slots[s].hi)
+                          {
+                              into.slots[s] = merged;
+                              changed = true;
+                          }
+                      }
+                      if (changed)
+                          work.insert(to);
+                  });
+        }
+
+        for (int round = 0; round < 3; round++)
+        {
+            std::vector<RangeState> next(blocks);
+            next[0] = in[0];
+            for (int block = 0; block < blocks; block++)
+                leave(block, in[block],
+                      [&](int to, const RangeState &state)
+                      {
+                          auto &into = next[to];
+                          if (!into.reached)
+                          {
+                              into = state;
+                              return;
+                          }
+                          for (int s = 0; s < variables; s++)
+                              into.slots[s] =
+                                  hull(into.slots[s], state.slots[s]);
+                      });
+            // only the bounds widening gave up on come back down
+            for (int block = 1; block < blocks; block++)
+            {
+                if (!next[block].reached)
+                    continue;
+                for (int s = 0; s < variables; s++)
+                {
+                    auto &old = in[block].slots[s];
+                    if (old.lo == INT64_MIN)
+                        old.lo = next[block].slots[s].lo;
+                    if (old.hi == INT64_MAX)
+                        old.hi = next[block].slots[s].hi;
+                }
+            }
+        }
+    }
+
+    const Program &program;
+    const Cfg &cfg;
+    std::vector<RangeState> in;
+};
+
+} // namespace
+
+static const char *operatorOf(OpCode op)
+{
+    switch (op)
+    {
+    case OpCode::OP_ADD:
+        return "+";
+    case OpCode::OP_SUB:
+        return "-";
+    case OpCode::OP_MUL:
+        return "*";
+    default:
+        return "/";
+    }
+}
+
+bool Optimizer::narrowRanges()
+{
+    auto &code = program->code;
+    MemoryScope scope("Ranges");
+    Cfg cfg(*program);
+    RangeAnalysis analysis(*program, cfg);
+    analysis.solve();
+
+    int variables = program->constantBase();
+    auto &report = results.ranges;
+    report.variables.assign(variables, VariableRange());
+    for (int s = 0; s < variables; s++)
+    {
+        report.variables[s].name = program->names[s];
+        report.variables[s].range = ValueRange{1, 0};
+    }
+
+    std::vector<bool> removed(code.size());
+    bool changed = false;
+    for (int block = 0; block < cfg.blocks.size(); block++)
+    {
+        auto state = analysis.in[block];
+        if (!state.reached)
+            continue;
+        auto &bb = cfg.blocks[block];
+        for (int i = bb.start; i < bb.end; i++)
+        {
+            auto &ins = code[i];
+            if (isBranch(ins.op))
+            {
+                auto a = analysis.get(state, ins.a);
+                auto b = analysis.get(state, ins.b);
+                int holds = ins.a == ins.b
+                                ? decide(ins.op, exactly(0), exactly(0))
+                                : decide(ins.op, a, b);
+                if (holds < 0)
+                    continue;
+                // an if jumps over its body when its condition fails, and
+                // straight to the label when its body is a goto
+                auto info = ins.stmt >= 0 ? &program->statements[ins.stmt]
+                                          : nullptr;
+                bool skips = info && info->type == AstType::AST_IF &&
+                             (info->body >= 0) != info->inverted;
+                remark(ins.stmt, holds != skips
+                                     ? "the condition always holds."
+                                     : "the condition never holds.");
+                if (holds)
+                    ins.op = OpCode::OP_JUMP;
+                else
+                    removed[i] = true;
+                changed = true;
+                continue;
+            }
+
+            int dst = definedSlot(ins);
+            if (dst < 0)
+                continue;
+            bool safe;
+            auto value = analysis.result(state, ins, safe);
+            auto &variable = report.variables[dst];
+            variable.assigned = true;
+            variable.range = hull(variable.range, value);
+
+            bool checked = ins.op == OpCode::OP_ADD ||
+                           ins.op == OpCode::OP_SUB ||
+                           ins.op == OpCode::OP_MUL || ins.op == OpCode::OP_DIV;
+            if (checked && !safe)
+                report.remainingChecks++;
+            else if (checked)
+            {
+                auto a = analysis.get(state, ins.a);
+                auto b = analysis.get(state, ins.b);
+                report.removedChecks++;
+                remark(ins.stmt,
+                       std::string("'") + operatorOf(ins.op) +
+                           "' can not fail, its operands stay within [" +
+                           std::to_string(a.lo) + ", " + std::to_string(a.hi) +
+                           "] and [" + std::to_string(b.lo) + ", " +
+                           std::to_string(b.hi) + "].");
+                ins.op = ins.op == OpCode::OP_ADD   ? OpCode::OP_ADD_UNCHECKED
+                         : ins.op == OpCode::OP_SUB ? OpCode::OP_SUB_UNCHECKED
+                         : ins.op == OpCode::OP_MUL ? OpCode::OP_MUL_UNCHECKED
+                                                    : OpCode::OP_DIV_UNCHECKED;
+                changed = true;
+            }
+            state.slots[dst] = value;
+        }
+    }
+
+    for (auto flag : removed)
+    {
+        if (flag)
+        {
+            removeInstructions(removed);
+            break;
+        }
+    }
+    return changed;
+}
+
+// the narrowest of 8, 16, 32 and 64 bits that holds every value of `range`
+static int bitsFor(const ValueRange &range)
+{
+    for (int bits : {8, 16, 32})
+    {
+        Value limit = (Value)1 << (bits - 1);
+        if (range.lo >= -limit && range.hi < limit)
+            return bits;
+    }
+    return 64;
+}
+
+void printRanges(std::ostream &out, const RangeReport &report)
+{
+    out << "===== ranges =====" << std::endl;
+    for (auto &variable : report.variables)
+    {
+        // a statement's temporary holds the values of every statement
+        if (variable.name == "$t")
+            continue;
+        out << std::left << std::setw(12) << variable.name << std::right;
+        if (!variable.assigned)
+            out << "never assigned" << std::endl;
+        else
+            out << "[" << variable.range.lo << ", " << variable.range.hi
+                << "]  i" << bitsFor(variable.range) << std::endl;
+    }
+    out << "checks removed: " << report.removedChecks
+        << ", remaining: " << report.remainingChecks << std::endl;
+    out << "===== end of ranges =====" << std::endl;
+}
+
+} // namespace sweet
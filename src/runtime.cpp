@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "sweet/memory.hpp"
+#include "sweet/profiler.hpp"
+#include "sweet/runtime.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Runtime
+// ==================================================
+
+Context::Context(const Program &program, std::ostream &out)
+    : program{&program}, out{&out}, pc{0}
+{
+    MemoryScope scope(MemoryPhase::PHASE_RUNTIME, "slots");
+    slots.resize(program.slotCount());
+    reset();
+}
+
+void Context::reset()
+{
+    int base = program->constantBase();
+    std::fill(slots.begin(), slots.begin() + base, 0);
+    std::copy(program->constants.begin(), program->constants.end(),
+              slots.begin() + base);
+    pc = 0;
+}
+
+bool Context::get(const std::string &name, Value &value) const
+{
+    int slot = program->slotOf(name);
+    if (slot < 0)
+        return false;
+    value = slots[slot];
+    return true;
+}
+
+bool Context::set(const std::string &name, Value value)
+{
+    int slot = program->slotOf(name);
+    if (slot < 0)
+        return false;
+    slots[slot] = value;
+    return true;
+}
+
+static RunResult runtimeError(Context &context, int pc, ErrorType type,
+                              std::string details)
+{
+    context.pc = pc;
+    auto &statement =
+        context.program->statements[context.program->code[pc].stmt];
+    return RunResult{RunStatus::ERROR,
+                     Error(type, details, statement.startPos, statement.endPos),
+                     0};
+}
+
+// the next sample is picked at random so that it can not fall into step
+// with a loop and keep timing the same instruction
+static std::uint64_t nextSample(Profile &profile)
+{
+    profile.seed ^= profile.seed << 13;
+    profile.seed ^= profile.seed >> 7;
+    profile.seed ^= profile.seed << 17;
+    return 1 + profile.seed % (2 * profile.period - 1);
+}
+
+// `Metered` runs charge one unit of fuel for every backward jump taken and
+// suspend at the first one they can not pay for, straight line code is never
+// charged.
+// `Profiled` runs count into `profile`
+template <bool Metered, bool Profiled>
+static RunResult execute(Context &context, std::int64_t fuel,
+                         Profile *profile)
+{
+    MemoryScope scope(MemoryPhase::PHASE_RUNTIME);
+    auto code = context.program->code.data();
+    auto slots = context.slots.data();
+    auto &out = *context.out;
+    int pc = context.pc;
+    int sampled = -1;
+    std::uint64_t sampleStart = 0;
+
+    for (;;)
+    {
+        if (Profiled)
+        {
+            profile->counts[pc]++;
+            if (sampled >= 0)
+            {
+                profile->ticks[sampled] += clockTicks() - sampleStart;
+                profile->samples[sampled]++;
+                sampled = -1;
+            }
+            if (--profile->countdown == 0)
+            {
+                profile->countdown = nextSample(*profile);
+                sampled = pc;
+                sampleStart = clockTicks();
+            }
+        }
+
+        auto &ins = code[pc];
+        bool taken = false;
+        switch (ins.op)
+        {
+        case OpCode::OP_MOVE:
+            slots[ins.dst] = slots[ins.a];
+            pc++;
+            continue;
+        case OpCode::OP_ADD:
+        {
+            Value value;
+            if (__builtin_add_overflow(slots[ins.a], slots[ins.b], &value))
+                return runtimeError(context, pc, ErrorType::OVERFLOW_ERROR,
+                                    "result of '+' does not fit in 64 bits.");
+            slots[ins.dst] = value;
+            pc++;
+            continue;
+        }
+        case OpCode::OP_SUB:
+        {
+            Value value;
+            if (__builtin_sub_overflow(slots[ins.a], slots[ins.b], &value))
+                return runtimeError(context, pc, ErrorType::OVERFLOW_ERROR,
+                                    "result of '-' does not fit in 64 bits.");
+            slots[ins.dst] = value;
+            pc++;
+            continue;
+        }
+        case OpCode::OP_MUL:
+        {
+            Value value;
+            if (__builtin_mul_overflow(slots[ins.a], slots[ins.b], &value))
+                return runtimeError(context, pc, ErrorType::OVERFLOW_ERROR,
+                                    "result of '*' does not fit in 64 bits.");
+            slots[ins.dst] = value;
+            pc++;
+            continue;
+        }
+        case OpCode::OP_DIV:
+        {
+            auto divisor = slots[ins.b];
+            if (divisor == 0)
+                return runtimeError(context, pc,
+                                    ErrorType::DIVISION_BY_ZERO_ERROR,
+                                    "division by zero.");
+            if (divisor == -1 && slots[ins.a] == INT64_MIN)
+                return runtimeError(context, pc, ErrorType::OVERFLOW_ERROR,
+                                    "result of '/' does not fit in 64 bits.");
+            slots[ins.dst] = slots[ins.a] / divisor;
+            pc++;
+            continue;
+        }
+        case OpCode::OP_ADD_UNCHECKED:
+            slots[ins.dst] = (std::uint64_t)slots[ins.a] + slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_SUB_UNCHECKED:
+            slots[ins.dst] = (std::uint64_t)slots[ins.a] - slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_MUL_UNCHECKED:
+            slots[ins.dst] = (std::uint64_t)slots[ins.a] * slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_DIV_UNCHECKED:
+            slots[ins.dst] = slots[ins.a] / slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_EQ:
+            slots[ins.dst] = slots[ins.a] == slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_LT:
+            slots[ins.dst] = slots[ins.a] < slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_LE:
+            slots[ins.dst] = slots[ins.a] <= slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_GT:
+            slots[ins.dst] = slots[ins.a] > slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_GE:
+            slots[ins.dst] = slots[ins.a] >= slots[ins.b];
+            pc++;
+            continue;
+        case OpCode::OP_PRINT:
+            out << slots[ins.a] << '\n';
+            pc++;
+            continue;
+        case OpCode::OP_JUMP:
+            taken = true;
+            break;
+        case OpCode::OP_JUMP_EQ:
+            taken = slots[ins.a] == slots[ins.b];
+            break;
+        case OpCode::OP_JUMP_NE:
+            taken = slots[ins.a] != slots[ins.b];
+            break;
+        case OpCode::OP_JUMP_LT:
+            taken = slots[ins.a] < slots[ins.b];
+            break;
+        case OpCode::OP_JUMP_LE:
+            taken = slots[ins.a] <= slots[ins.b];
+            break;
+        case OpCode::OP_JUMP_GT:
+            taken = slots[ins.a] > slots[ins.b];
+            break;
+        case OpCode::OP_JUMP_GE:
+            taken = slots[ins.a] >= slots[ins.b];
+            break;
+        case OpCode::OP_LOOP:
+        {
+            // the iterations done here skip their backward jumps, a metered
+            // run only does so when it could pay for them and still have a
+            // unit left for the jump out, which must not suspend after the
+            // loop already ran
+            auto &loop = context.program->loops[ins.a];
+            auto maxTrips = Metered && loop.closed ? fuel : INT64_MAX;
+            auto trips = Metered && fuel == 0
+                             ? -1
+                             : runLoop(*context.program, loop, slots,
+                                       maxTrips);
+            if (trips < 0)
+            {
+                pc++;
+                continue;
+            }
+            if (Metered && loop.closed)
+                fuel -= trips - 1;
+            taken = true;
+            break;
+        }
+        case OpCode::OP_HALT:
+            context.pc = pc;
+            return RunResult{RunStatus::FINISHED, Error(), fuel};
+        }
+
+        if (!taken)
+        {
+            pc++;
+            continue;
+        }
+        if (Metered && ins.target <= pc && fuel-- == 0)
+        {
+            // a branch only reads slots, so it decides the same way again
+            // once the run resumes at it, and is counted then
+            if (Profiled)
+                profile->counts[pc]--;
+            context.pc = pc;
+            return RunResult{RunStatus::SUSPENDED, Error(), 0};
+        }
+        if (Profiled)
+            profile->jumps[pc]++;
+        pc = ins.target;
+    }
+}
+
+RunResult run(Context &context)
+{
+    return execute<false, false>(context, -1, nullptr);
+}
+
+RunResult run(Context &context, std::int64_t fuel)
+{
+    return execute<true, false>(context, fuel, nullptr);
+}
+
+RunResult run(Context &context, Profile &profile)
+{
+    return run(context, profile, -1);
+}
+
+RunResult run(Context &context, Profile &profile, std::int64_t fuel)
+{
+    auto startNs = std::chrono::steady_clock::now();
+    auto result = fuel >= 0 ? execute<true, true>(context, fuel, &profile)
+                            : execute<false, true>(context, -1, &profile);
+    profile.totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - startNs)
+                           .count();
+    return result;
+}
+
+} // namespace sweet
@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#include "sweet/scheduler.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Scheduler
+// ==================================================
+
+Scheduler::Scheduler(int workers, std::int64_t slice) : slice{slice}
+{
+    for (int i = 0; i < std::max(workers, 1); i++)
+        threads.emplace_back(&Scheduler::work, this);
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+}
+
+void Scheduler::submit(std::shared_ptr<Task> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(task);
+        pending++;
+    }
+    ready.notify_one();
+}
+
+void Scheduler::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+}
+
+void Scheduler::work()
+{
+    for (;;)
+    {
+        std::shared_ptr<Task> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            task = queue.front();
+            queue.pop_front();
+        }
+
+        auto fuel = slice;
+        if (task->limit >= 0)
+            fuel = std::min(fuel, task->limit - task->used);
+        task->result = run(task->context, fuel);
+        task->used += fuel - task->result.fuel;
+
+        bool finished = task->result.status != RunStatus::SUSPENDED ||
+                        (task->limit >= 0 && task->used >= task->limit);
+        if (!finished)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(task);
+            continue;
+        }
+
+        if (task->done)
+            task->done(*task);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+            if (pending == 0)
+                idle.notify_all();
+        }
+    }
+}
+
+} // namespace sweet
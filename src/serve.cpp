@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "sweet/channel.hpp"
+#include "sweet/serve.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Serve
+// ==================================================
+
+// A request is a line with the protocol version, a line with the number of
+// arguments and then every argument and the source, each as its length on a
+// line followed by that many bytes. The answer is any number of 'o' (stdout)
+// and 'e' (stderr) frames, each a length on a line and that many bytes, and
+// last an 'x' line with the exit status.
+static const char *const VERSION = "sweet-serve 1";
+
+bool optionTakesValue(const std::string &arg)
+{
+    static const char *const options[] = {
+        "--tier-up",     "--fuel",         "--profile-out", "--profile-generate",
+        "--profile-use", "--batch",        "--records",     "--workers",
+        "--cache-dir",   "--cache-size",   "--socket",      "--request-fuel"};
+    for (auto option : options)
+        if (arg == option)
+            return true;
+    return false;
+}
+
+std::string defaultSocketPath()
+{
+    if (auto runtime = std::getenv("XDG_RUNTIME_DIR"); runtime && *runtime)
+        return std::string(runtime) + "/sweet.sock";
+    return "/tmp/sweet-" + std::to_string(getuid()) + ".sock";
+}
+
+static bool writeAll(int fd, const char *data, std::size_t size)
+{
+    while (size)
+    {
+        auto count = send(fd, data, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == ENOTSOCK)
+            count = write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+// buffered reads of lines and runs of bytes from a socket
+struct Reader
+{
+    Reader(int fd) : fd{fd} {}
+
+    bool line(std::string &text)
+    {
+        text.clear();
+        for (;;)
+        {
+            auto newline = buffer.find('\n', start);
+            if (newline != std::string::npos)
+            {
+                text.assign(buffer, start, newline - start);
+                start = newline + 1;
+                return true;
+            }
+            if (!fill())
+                return false;
+        }
+    }
+
+    bool bytes(std::size_t size, std::string &text)
+    {
+        while (buffer.size() - start < size)
+            if (!fill())
+                return false;
+        text.assign(buffer, start, size);
+        start += size;
+        return true;
+    }
+
+    bool number(std::size_t &value)
+    {
+        std::string text;
+        if (!line(text) || text.empty() ||
+            text.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        value = std::strtoull(text.c_str(), nullptr, 10);
+        return true;
+    }
+
+private:
+    bool fill()
+    {
+        buffer.erase(0, start);
+        start = 0;
+        char chunk[1 << 16];
+        for (;;)
+        {
+            auto count = read(fd, chunk, sizeof(chunk));
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            buffer.append(chunk, count);
+            return true;
+        }
+    }
+
+    int fd;
+    std::string buffer;
+    std::size_t start = 0;
+};
+
+// sends what is written to it as frames of `kind`, whenever its buffer fills
+// up or the stream is flushed
+struct FrameBuffer : std::streambuf
+{
+    FrameBuffer(int fd, char kind) : fd{fd}, kind{kind} {}
+
+    ~FrameBuffer() { sync(); }
+
+    int overflow(int c) override
+    {
+        if (c != EOF)
+            pending += (char)c;
+        if (c == EOF || pending.size() >= FRAME_BYTES)
+            return sync() == 0 ? 0 : EOF;
+        return c;
+    }
+
+    std::streamsize xsputn(const char *data, std::streamsize count) override
+    {
+        pending.append(data, count);
+        if (pending.size() >= FRAME_BYTES && sync() != 0)
+            return 0;
+        return count;
+    }
+
+    int sync() override
+    {
+        if (pending.empty())
+            return 0;
+        auto header = kind + std::to_string(pending.size()) + "\n";
+        bool sent = writeAll(fd, header.data(), header.size()) &&
+                    writeAll(fd, pending.data(), pending.size());
+        pending.clear();
+        return sent ? 0 : -1;
+    }
+
+private:
+    static const std::size_t FRAME_BYTES = 1 << 16;
+    int fd;
+    char kind;
+    std::string pending;
+};
+
+static void answer(int fd, const ServeHandler &handler)
+{
+    Reader reader(fd);
+    std::string line, source;
+    std::size_t count, size;
+    if (!reader.line(line) || line != VERSION || !reader.number(count))
+        return;
+    std::vector<std::string> args(count);
+    for (auto &arg : args)
+        if (!reader.number(size) || !reader.bytes(size, arg))
+            return;
+    if (!reader.number(size) || !reader.bytes(size, source))
+        return;
+
+    int status;
+    {
+        FrameBuffer outBuffer(fd, 'o'), errBuffer(fd, 'e');
+        std::ostream out(&outBuffer), err(&errBuffer);
+        // stderr goes out as it is written, the way it does on a terminal
+        err.setf(std::ios::unitbuf);
+        status = handler(args, source, out, err);
+        out.flush();
+    }
+    auto last = "x" + std::to_string(status) + "\n";
+    writeAll(fd, last.data(), last.size());
+}
+
+// the socket SIGINT and SIGTERM remove, kept where a signal handler can
+// reach it
+static char socketPath[sizeof(sockaddr_un::sun_path)];
+
+static void stop(int)
+{
+    unlink(socketPath);
+    _exit(0);
+}
+
+static bool address(const std::string &path, sockaddr_un &where)
+{
+    if (path.size() >= sizeof(where.sun_path))
+        return false;
+    std::memset(&where, 0, sizeof(where));
+    where.sun_family = AF_UNIX;
+    std::memcpy(where.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+std::string serve(const std::string &path, int workers,
+                  const ServeHandler &handler)
+{
+    sockaddr_un where;
+    if (!address(path, where))
+        return "the socket path '" + path + "' is too long.";
+
+    // a socket nobody answers on is left over from a daemon that died
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool answered =
+        probe >= 0 && connect(probe, (sockaddr *)&where, sizeof(where)) == 0;
+    if (probe >= 0)
+        close(probe);
+    if (answered)
+        return "a daemon is already serving on '" + path + "'.";
+    unlink(path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+        return std::string("could not create a socket: ") + strerror(errno) +
+               ".";
+    auto mask = umask(0077);
+    bool bound = bind(listener, (sockaddr *)&where, sizeof(where)) == 0;
+    umask(mask);
+    if (!bound || listen(listener, SOMAXCONN) != 0)
+    {
+        auto reason = std::string("could not listen on '") + path +
+                      "': " + strerror(errno) + ".";
+        close(listener);
+        return reason;
+    }
+    std::memcpy(socketPath, where.sun_path, sizeof(socketPath));
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (workers <= 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    Channel<int> connections(workers * 4);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; i++)
+        threads.emplace_back(
+            [&]()
+            {
+                int fd;
+                while (connections.pop(fd))
+                {
+                    answer(fd, handler);
+                    close(fd);
+                }
+            });
+    for (;;)
+    {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0)
+            connections.push(fd);
+        else if (errno != EINTR && errno != ECONNABORTED)
+            break;
+    }
+
+    auto reason = std::string("could not accept a connection: ") +
+                  strerror(errno) + ".";
+    connections.close();
+    for (auto &thread : threads)
+        thread.join();
+    close(listener);
+    unlink(path.c_str());
+    return reason;
+}
+
+int requestServe(const std::string &path, const std::vector<std::string> &args,
+                 const std::string &source, int outFd, int errFd,
+                 std::string &error)
+{
+    sockaddr_un where;
+    if (!address(path, where))
+    {
+        error = "the socket path '" + path + "' is too long.";
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&where, sizeof(where)) != 0)
+    {
+        error = "no daemon is serving on '" + path +
+                "', start one with sweet --serve.";
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    std::string request = std::string(VERSION) + "\n" +
+                          std::to_string(args.size()) + "\n";
+    for (auto &arg : args)
+        request += std::to_string(arg.size()) + "\n" + arg;
+    request += std::to_string(source.size()) + "\n" + source;
+    if (!writeAll(fd, request.data(), request.size()))
+    {
+        error = std::string("could not send the request: ") + strerror(errno) +
+                ".";
+        close(fd);
+        return -1;
+    }
+
+    Reader reader(fd);
+    std::string line, data;
+    std::size_t size;
+    while (reader.line(line) && line.size() > 1)
+    {
+        auto kind = line[0];
+        if (kind == 'x')
+        {
+            close(fd);
+            return std::atoi(line.c_str() + 1);
+        }
+        size = std::strtoull(line.c_str() + 1, nullptr, 10);
+        if ((kind != 'o' && kind != 'e') || !reader.bytes(size, data))
+            break;
+        writeAll(kind == 'o' ? outFd : errFd, data.data(), data.size());
+    }
+    close(fd);
+    error = "the daemon on '" + path + "' hung up before answering.";
+    return -1;
+}
+
+} // namespace sweet
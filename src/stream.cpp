@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sweet/channel.hpp"
+#include "sweet/runtime.hpp"
+#include "sweet/stream.hpp"
+#include "sweet/token.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Stream
+// ==================================================
+
+// whole lines of input, numbered from `firstLine`
+struct Lines
+{
+    std::int64_t seq;
+    std::int64_t firstLine;
+    std::shared_ptr<std::string> owned; // the lines when they are not mapped
+    const char *begin, *end;
+};
+
+// what running a block gave
+struct Printed
+{
+    std::int64_t seq;
+    std::string out, err;
+    std::int64_t records = 0, failed = 0;
+};
+
+// hands out the input in runs of whole lines, straight from a mapping of a
+// regular file or copied out of whatever else it is
+struct InputReader
+{
+    InputReader(int fd) : fd{fd}
+    {
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                             0);
+            if (map != MAP_FAILED)
+            {
+                madvise(map, info.st_size, MADV_SEQUENTIAL);
+                mapped = (const char *)map;
+                size = info.st_size;
+            }
+        }
+    }
+
+    ~InputReader()
+    {
+        if (mapped)
+            munmap((void *)mapped, size);
+    }
+
+    InputReader(const InputReader &) = delete;
+    InputReader &operator=(const InputReader &) = delete;
+
+    // at least `bytes` of input, or what is left of it, extended to the end
+    // of the line; false once there is nothing left
+    bool next(std::size_t bytes, Lines &block)
+    {
+        if (mapped)
+        {
+            if (offset >= size)
+                return false;
+            auto end = std::min(offset + bytes, size);
+            auto newline = (const char *)memchr(mapped + end - 1, '\n',
+                                                size - end + 1);
+            end = newline ? newline - mapped + 1 : size;
+            block.owned = nullptr;
+            block.begin = mapped + offset;
+            block.end = mapped + end;
+            offset = end;
+            return true;
+        }
+
+        auto buffer = std::make_shared<std::string>(std::move(carry));
+        carry.clear();
+        std::size_t searched = 0;
+        for (;;)
+        {
+            auto newline = buffer->find('\n', searched);
+            if (buffer->size() >= bytes && newline != std::string::npos)
+            {
+                auto last = buffer->rfind('\n');
+                carry.assign(*buffer, last + 1, std::string::npos);
+                buffer->resize(last + 1);
+                break;
+            }
+            searched = buffer->size();
+            if (ended)
+                break;
+            auto have = buffer->size();
+            buffer->resize(have + std::max(bytes, (std::size_t)4096));
+            auto got = read(fd, &(*buffer)[have], buffer->size() - have);
+            if (got < 0 && errno == EINTR)
+                got = 0;
+            else if (got <= 0)
+                ended = true;
+            buffer->resize(have + std::max(got, (ssize_t)0));
+        }
+        if (buffer->empty())
+            return false;
+        block.owned = buffer;
+        block.begin = buffer->data();
+        block.end = buffer->data() + buffer->size();
+        return true;
+    }
+
+private:
+    int fd;
+    const char *mapped = nullptr;
+    std::size_t size = 0, offset = 0;
+    std::string carry;
+    bool ended = false;
+};
+
+static bool isSeparator(char c)
+{
+    return c == ',' || c == ' ' || c == '\t' || c == '\r';
+}
+
+// the variables the header line names, in field order
+static std::vector<int> readHeader(const Program &program, const char *begin,
+                                   const char *end, const std::string &name,
+                                   std::vector<Error> &errors)
+{
+    std::vector<int> slots;
+    std::unordered_set<std::string> seen;
+    Position pos(name);
+    auto at = begin;
+    auto move = [&](const char *to)
+    {
+        for (; at < to; at++)
+            pos.advance(*at);
+    };
+    while (at < end && *at != '\n')
+    {
+        if (isSeparator(*at))
+        {
+            move(at + 1);
+            continue;
+        }
+        auto start = pos;
+        auto last = at;
+        while (last < end && !isSeparator(*last) && *last != '\n')
+            last++;
+        std::string field(at, last);
+        move(last);
+        std::string problem;
+        if (!(isalpha(field[0]) || field[0] == '_') ||
+            !std::all_of(field.begin(), field.end(),
+                         [](char c) { return isalnum(c) || c == '_'; }) ||
+            keywordType(field) != TokenType::TT_VARIABLE)
+            problem = "'" + field + "' is not the name of a variable.";
+        else if (!seen.insert(field).second)
+            problem = "variable '" + field + "' already has a field.";
+        else if (program.slotOf(field) < 0)
+            problem = "the program does not use the variable '" + field + "'.";
+        if (problem != "")
+            errors.push_back(Error(ErrorType::INPUT_ERROR, problem, start,
+                                   pos));
+        slots.push_back(program.slotOf(field));
+    }
+    if (slots.empty())
+        errors.push_back(Error(ErrorType::INPUT_ERROR,
+                               "expected the names of the fields.", pos, pos));
+    return slots;
+}
+
+// runs every record of `block`
+static void runBlock(Context &context, std::ostringstream &out,
+                     const std::vector<int> &slots, const Lines &block,
+                     const std::string &inputName, Printed &output)
+{
+    std::vector<Value> fields(slots.size());
+    auto line = block.firstLine;
+    for (auto at = block.begin; at < block.end; line++)
+    {
+        auto newline = (const char *)memchr(at, '\n', block.end - at);
+        auto end = newline ? newline : block.end;
+        auto next = newline ? newline + 1 : block.end;
+
+        int count = 0;
+        const char *problem = nullptr;
+        auto field = at;
+        while (field < end)
+        {
+            if (isSeparator(*field))
+            {
+                field++;
+                continue;
+            }
+            auto last = field;
+            while (last < end && !isSeparator(*last))
+                last++;
+            Value value;
+            auto parsed = std::from_chars(field, last, value);
+            if (parsed.ec == std::errc::result_out_of_range)
+                problem = "does not fit in a 64 bit integer.";
+            else if (parsed.ec != std::errc() || parsed.ptr != last)
+                problem = "is not a number.";
+            else if (count < fields.size())
+                fields[count] = value;
+            if (problem)
+            {
+                output.err += inputName + ":" + std::to_string(line) + ":" +
+                              std::to_string(field - at + 1) +
+                              " InputError: field '" +
+                              std::string(field, last) + "' " + problem + "\n";
+                break;
+            }
+            count++;
+            field = last;
+        }
+        at = next;
+        if (!problem && count == 0)
+            continue;
+        output.records++;
+        if (problem)
+        {
+            output.failed++;
+            continue;
+        }
+        if (count != fields.size())
+        {
+            output.failed++;
+            output.err += inputName + ":" + std::to_string(line) +
+                          ":1 InputError: expected " +
+                          std::to_string(fields.size()) + " fields, found " +
+                          std::to_string(count) + ".\n";
+            continue;
+        }
+
+        context.reset();
+        for (int i = 0; i < slots.size(); i++)
+            context.slots[slots[i]] = fields[i];
+        auto result = run(context);
+        if (result.status == RunStatus::ERROR)
+        {
+            output.failed++;
+            std::ostringstream message;
+            message << result.error << " (record at " << inputName << ":"
+                    << line << ")\n";
+            output.err += message.str();
+        }
+    }
+    output.out = out.str();
+    out.str(std::string());
+}
+
+static bool writeAll(int fd, const std::string &data)
+{
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        auto count = write(fd, data.data() + written, data.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        written += count;
+    }
+    return true;
+}
+
+StreamResult runStream(const Program &program, int input,
+                       const std::string &inputName, int output, int errors,
+                       const StreamOptions &options)
+{
+    StreamResult result;
+    auto start = std::chrono::steady_clock::now();
+    InputReader reader(input);
+
+    Lines header;
+    if (!reader.next(1, header))
+    {
+        result.errors.push_back(Error(ErrorType::INPUT_ERROR,
+                                      "expected the names of the fields.",
+                                      Position(inputName), Position(inputName)));
+        return result;
+    }
+    // the header may have come with records when it was not mapped
+    auto headerEnd = (const char *)memchr(header.begin, '\n',
+                                          header.end - header.begin);
+    headerEnd = headerEnd ? headerEnd + 1 : header.end;
+    auto slots = readHeader(program, header.begin, headerEnd, inputName,
+                            result.errors);
+    if (result.errors.size())
+        return result;
+
+    int workers = options.workers;
+    if (workers <= 0)
+        workers = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+    Channel<Lines> blocks(2 * workers);
+    Channel<Printed> outputs(2 * workers);
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> running{workers};
+    std::atomic<std::int64_t> bytesIn{0};
+
+    std::thread readerThread(
+        [&]()
+        {
+            std::int64_t seq = 0, line = 2;
+            auto hand = [&](Lines block)
+            {
+                block.seq = seq++;
+                block.firstLine = line;
+                line += std::count(block.begin, block.end, '\n');
+                bytesIn += block.end - block.begin;
+                blocks.push(std::move(block));
+            };
+            if (headerEnd < header.end)
+            {
+                auto rest = header;
+                rest.begin = headerEnd;
+                hand(rest);
+            }
+            Lines block;
+            while (!cancelled && reader.next(options.blockBytes, block))
+                hand(block);
+            blocks.close();
+        });
+
+    std::vector<std::thread> workerThreads;
+    for (int i = 0; i < workers; i++)
+        workerThreads.emplace_back(
+            [&]()
+            {
+                std::ostringstream out;
+                Context context(program, out);
+                Lines block;
+                while (blocks.pop(block))
+                {
+                    Printed result;
+                    result.seq = block.seq;
+                    runBlock(context, out, slots, block, inputName, result);
+                    outputs.push(std::move(result));
+                }
+                if (--running == 0)
+                    outputs.close();
+            });
+
+    // blocks finish out of order, they are written in order
+    std::map<std::int64_t, Printed> waiting;
+    std::int64_t next = 0;
+    Printed done;
+    bool writing = true;
+    while (outputs.pop(done))
+    {
+        waiting[done.seq] = std::move(done);
+        for (auto it = waiting.begin();
+             it != waiting.end() && it->first == next; it = waiting.erase(it))
+        {
+            auto &ready = it->second;
+            result.value.records += ready.records;
+            result.value.failed += ready.failed;
+            result.value.bytesOut += ready.out.size();
+            if (writing &&
+                (!writeAll(output, ready.out) || !writeAll(errors, ready.err)))
+            {
+                writing = false;
+                cancelled = true;
+                result.errors.push_back(Error(
+                    ErrorType::INPUT_ERROR,
+                    std::string("could not write the output: ") +
+                        strerror(errno) + ".",
+                    Position(inputName), Position(inputName)));
+            }
+            next++;
+        }
+    }
+
+    readerThread.join();
+    for (auto &thread : workerThreads)
+        thread.join();
+    result.value.bytesIn = bytesIn + (headerEnd - header.begin);
+    result.value.seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    return result;
+}
+
+} // namespace sweet
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+#include "sweet/tier.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Tiered execution
+// ==================================================
+
+static std::int64_t
+nanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// `program` with a jump to `pc` in front, which the optimizer sees as a
+// program that starts there with whatever is in the variables
+static Program enteredAt(const Program &program, int pc)
+{
+    MemoryScope scope(MemoryPhase::PHASE_OPTIMIZER, "Program");
+    Program entered = program;
+    for (auto &ins : entered.code)
+        if (isJump(ins.op))
+            ins.target++;
+    entered.code.insert(entered.code.begin(),
+                        Instruction{OpCode::OP_JUMP, 0, 0, 0, pc + 1, -1});
+    return entered;
+}
+
+// backward jumps the optimized code runs between asking whether to stop
+static const std::int64_t OPTIMIZED_SLICE = 1 << 20;
+
+// whether a run that just took slices of `fuel` has to end here
+static bool stopped(const RunResult &result, std::int64_t fuel,
+                    const TierOptions &options)
+{
+    return result.status != RunStatus::SUSPENDED || fuel == 0 ||
+           (options.cancelled && options.cancelled());
+}
+
+RunResult runTiered(const Program &program, std::ostream &out,
+                    const TierOptions &options, TierStats &stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto slice = std::max<std::int64_t>(options.slice, 1);
+    auto fuel = options.fuel;
+    stats.instructions[0] = program.code.size();
+    Context context(program, out);
+    // backward jumps into every instruction, each only as precise as a slice
+    std::vector<std::int64_t> heat;
+    {
+        MemoryScope scope(MemoryPhase::PHASE_RUNTIME, "heat");
+        heat.resize(program.code.size());
+    }
+    for (;;)
+    {
+        auto budget = fuel >= 0 ? std::min(slice, fuel) : slice;
+        auto result = run(context, budget);
+        stats.baselineJumps += budget - result.fuel;
+        if (fuel >= 0)
+            fuel -= budget - result.fuel;
+        if (stopped(result, fuel, options))
+        {
+            stats.baselineNs = nanosecondsSince(start);
+            return result;
+        }
+        // the run stopped at a backward jump it takes once resumed, which
+        // reads nothing it could change, so the loop can as well be entered
+        // at its top
+        int pc = program.code[context.pc].target;
+        heat[pc] += budget;
+        if (heat[pc] < options.threshold || program.code[pc].stmt < 0)
+            continue;
+
+        stats.baselineNs = nanosecondsSince(start);
+        stats.tieredUp = true;
+        stats.loop = program.statements[program.code[pc].stmt].startPos;
+        stats.loopJumps = heat[pc];
+        start = std::chrono::steady_clock::now();
+        Optimizer optimizer(enteredAt(program, pc));
+        auto optimized = optimizer.optimize().value;
+        stats.optimizeNs = nanosecondsSince(start);
+        stats.instructions[1] = optimized->code.size();
+
+        // the optimizer adds constants but never variables, those keep their
+        // slots
+        start = std::chrono::steady_clock::now();
+        Context next(*optimized, out);
+        std::copy(context.slots.begin(),
+                  context.slots.begin() + program.constantBase(),
+                  next.slots.begin());
+        if (fuel < 0 && !options.cancelled)
+            result = run(next);
+        else
+            for (;;)
+            {
+                budget = fuel >= 0 ? std::min(OPTIMIZED_SLICE, fuel)
+                                   : OPTIMIZED_SLICE;
+                result = run(next, budget);
+                if (fuel >= 0)
+                    fuel -= budget - result.fuel;
+                if (stopped(result, fuel, options))
+                    break;
+            }
+        stats.optimizedNs = nanosecondsSince(start);
+        return result;
+    }
+}
+
+void printTierStats(std::ostream &out, const TierStats &stats)
+{
+    out << "===== tiers =====" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    out << "baseline: " << stats.baselineJumps << " backward jumps in "
+        << stats.baselineNs / 1e6 << " ms" << std::endl;
+    if (!stats.tieredUp)
+        out << "tier up: none, no loop got hot" << std::endl;
+    else
+    {
+        out << "tier up: at " << stats.loop << " after " << stats.loopJumps
+            << " backward jumps into it" << std::endl;
+        out << "optimizing: " << stats.optimizeNs / 1e6 << " ms, "
+            << stats.instructions[0] << " -> " << stats.instructions[1]
+            << " instructions" << std::endl;
+        out << "optimized: " << stats.optimizedNs / 1e6 << " ms" << std::endl;
+    }
+    out << "===== end of tiers =====" << std::endl;
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
+
+} // namespace sweet
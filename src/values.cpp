@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "sweet/memory.hpp"
+#include "sweet/optimizer.hpp"
+
+namespace sweet
+{
+
+// ==================================================
+// Value numbering
+// ==================================================
+
+// the values held in the slots as the code is read in order, each value
+// numbered once, so that two slots holding the same number hold the same
+// value whatever the program was started with
+struct ValueTable
+{
+    ValueTable(const Program &program)
+        : program{program}, stamp(program.slotCount(), 0),
+          number(program.slotCount())
+    {
+    }
+
+    // forgets every slot, as at a label a jump back goes to
+    void clear(int at)
+    {
+        epoch++;
+        holders.clear();
+        changes.clear();
+        clearedAt = at;
+    }
+
+    // at a label only jumps from `from` on and the code before it go to,
+    // every slot none of them changed since `from` holds the same value
+    // whichever way it came
+    void merge(int from, int at)
+    {
+        if (clearedAt >= from)
+        {
+            clear(at);
+            return;
+        }
+        std::vector<int> changed;
+        while (changes.size() && changes.back().first >= from)
+        {
+            changed.push_back(changes.back().second);
+            changes.pop_back();
+        }
+        for (auto slot : changed)
+            if (stamp[slot] == epoch)
+            {
+                release(slot);
+                stamp[slot] = 0;
+                changes.push_back({at, slot});
+            }
+    }
+
+    int valueOf(int slot)
+    {
+        if (program.isConstant(slot))
+        {
+            auto value = program.constantValue(slot);
+            auto it = constants.find(value);
+            if (it != constants.end())
+                return it->second;
+            constantSlot[next] = slot;
+            return constants[value] = next++;
+        }
+        // naming the value a slot had all along changes nothing
+        if (stamp[slot] != epoch)
+        {
+            stamp[slot] = epoch;
+            number[slot] = next++;
+            holders[number[slot]].push_back(slot);
+        }
+        return number[slot];
+    }
+
+    // slot to read `value` from, preferring a constant, then the variable
+    // that has held it longest and only then the temporary, whose range
+    // covers every statement. -1 when no slot holds it any more
+    int holder(int value)
+    {
+        auto constant = constantSlot.find(value);
+        if (constant != constantSlot.end())
+            return constant->second;
+        auto it = holders.find(value);
+        if (it == holders.end() || it->second.empty())
+            return -1;
+        for (auto slot : it->second)
+            if (program.names[slot] != "$t")
+                return slot;
+        return it->second.front();
+    }
+
+    bool holds(int slot, int value) const
+    {
+        return !program.isConstant(slot) && stamp[slot] == epoch &&
+               number[slot] == value;
+    }
+
+    void assign(int slot, int value, int at)
+    {
+        if (stamp[slot] == epoch)
+            release(slot);
+        stamp[slot] = epoch;
+        number[slot] = value;
+        holders[value].push_back(slot);
+        changes.push_back({at, slot});
+    }
+
+    // number of `a op b`, a new one unless the same operation on the same
+    // values was seen before. `seen` tells which. Numbers stand for the same
+    // value on every path, so these are never forgotten
+    int expression(OpCode op, int a, int b, bool &seen)
+    {
+        auto key = std::make_tuple((int)op, a, b);
+        auto it = expressions.find(key);
+        seen = it != expressions.end();
+        if (seen)
+            return it->second;
+        return expressions[key] = next++;
+    }
+
+private:
+    void release(int slot)
+    {
+        auto &old = holders[number[slot]];
+        for (int i = 0; i < old.size(); i++)
+            if (old[i] == slot)
+            {
+                old.erase(old.begin() + i);
+                break;
+            }
+    }
+
+    const Program &program;
+    int next = 0, epoch = 1, clearedAt = 0;
+    std::vector<int> stamp, number; // number of a slot is current when its
+                                    // stamp is the epoch
+    std::unordered_map<int, std::vector<int>> holders; // in order assigned
+    std::vector<std::pair<int, int>> changes; // instruction and slot, since
+                                              // the last clear
+    std::map<std::tuple<int, int, int>, int> expressions;
+    std::unordered_map<Value, int> constants;
+    std::unordered_map<int, int> constantSlot;
+};
+
+// the checked and unchecked forms of an operation compute the same value,
+// and a comparison is the same as its mirror image with the operands swapped
+static OpCode canonical(OpCode op, int &a, int &b)
+{
+    switch (op)
+    {
+    case OpCode::OP_ADD_UNCHECKED:
+        op = OpCode::OP_ADD;
+        break;
+    case OpCode::OP_SUB_UNCHECKED:
+        op = OpCode::OP_SUB;
+        break;
+    case OpCode::OP_MUL_UNCHECKED:
+        op = OpCode::OP_MUL;
+        break;
+    case OpCode::OP_DIV_UNCHECKED:
+        op = OpCode::OP_DIV;
+        break;
+    case OpCode::OP_GT:
+        std::swap(a, b);
+        return OpCode::OP_LT;
+    case OpCode::OP_GE:
+        std::swap(a, b);
+        return OpCode::OP_LE;
+    default:
+        break;
+    }
+    if ((op == OpCode::OP_ADD || op == OpCode::OP_MUL ||
+         op == OpCode::OP_EQ) &&
+        a > b)
+        std::swap(a, b);
+    return op;
+}
+
+bool Optimizer::numberValues()
+{
+    auto &code = program->code;
+    MemoryScope scope("ValueTable");
+    // where the first jump to every instruction comes from, and whether
+    // any comes from behind it or is an OP_LOOP, which writes what is not
+    // in the code
+    std::vector<int> earliest(code.size(), code.size());
+    std::vector<bool> unknown(code.size());
+    for (int i = 0; i < code.size(); i++)
+    {
+        auto &ins = code[i];
+        if (!isJump(ins.op))
+            continue;
+        earliest[ins.target] = std::min(earliest[ins.target], i);
+        if (ins.target <= i || ins.op == OpCode::OP_LOOP)
+            unknown[ins.target] = true;
+    }
+
+    ValueTable values(*program);
+    std::vector<bool> removed(code.size());
+    bool changed = false;
+    for (int i = 0; i < code.size(); i++)
+    {
+        auto &ins = code[i];
+        bool fallsIn = i > 0 && code[i - 1].op != OpCode::OP_JUMP &&
+                       code[i - 1].op != OpCode::OP_HALT &&
+                       code[i - 1].op != OpCode::OP_LOOP;
+        if (unknown[i] || (i > 0 && !fallsIn && earliest[i] == code.size()))
+            values.clear(i);
+        else if (earliest[i] < code.size())
+            values.merge(earliest[i], i);
+        if (ins.op == OpCode::OP_LOOP)
+            continue;
+
+        // read every operand from the slot the value is best kept in. A
+        // variable stepping itself keeps reading itself, the way the loop
+        // optimizations look for it
+        int defined = definedSlot(ins);
+        int used[2];
+        int count = usedSlots(ins, used);
+        for (int u = 0; u < count; u++)
+        {
+            int slot = used[u];
+            int from = values.holder(values.valueOf(slot));
+            if (from < 0 || from == slot || slot == defined)
+                continue;
+            (u == 0 ? ins.a : ins.b) = from;
+            results.values.propagated++;
+            changed = true;
+        }
+
+        if (defined < 0)
+            continue;
+        int value;
+        if (ins.op == OpCode::OP_MOVE)
+            value = values.valueOf(ins.a);
+        else
+        {
+            int a = values.valueOf(ins.a), b = values.valueOf(ins.b);
+            auto op = canonical(ins.op, a, b);
+            bool seen;
+            value = values.expression(op, a, b, seen);
+            int from = seen ? values.holder(value) : -1;
+            // the operation already ran on the same values without failing,
+            // so copying its result can not fail either
+            if (from >= 0)
+            {
+                ins = Instruction{OpCode::OP_MOVE, defined, from, 0, -1,
+                                  ins.stmt};
+                results.values.reused++;
+                changed = true;
+                remark(ins.stmt, "copied the value of '" +
+                                     program->names[defined] +
+                                     "' from where it was computed before.");
+            }
+        }
+        if (ins.op == OpCode::OP_MOVE && values.holds(defined, value))
+        {
+            removed[i] = true;
+            results.values.copies++;
+            changed = true;
+            remark(ins.stmt, "removed the copy to '" +
+                                 program->names[defined] +
+                                 "', it already holds that value.");
+            continue;
+        }
+        values.assign(defined, value, i);
+    }
+
+    if (std::find(removed.begin(), removed.end(), true) != removed.end())
+        removeInstructions(removed);
+    return changed;
+}
+
+void printValues(std::ostream &out, const ValueReport &report)
+{
+    out << "===== values =====" << std::endl;
+    out << "operations reused: " << report.reused << std::endl;
+    out << "copies removed: " << report.copies << std::endl;
+    out << "operands propagated: " << report.propagated << std::endl;
+    out << "instructions: " << report.instructions[0] << " -> "
+        << report.instructions[1] << std::endl;
+    out << "variables used: " << report.variables[0] << " -> "
+        << report.variables[1] << std::endl;
+    out << "===== end of values =====" << std::endl;
+}
+
+} // namespace sweet